@@ -11,6 +11,7 @@
 #include "K2Node_DynamicCast.h"
 #include "K2Node_IfThenElse.h"
 #include "K2Node_TemporaryVariable.h"
+#include "Kismet2/CompilerResultsLog.h"
 
 #include "Runtime/Launch/Resources/Version.h"
 
@@ -25,17 +26,20 @@ UK2Node_State::UK2Node_State(const FObjectInitializer& ObjectInitializer)
 	ProxyClass = UState::StaticClass();
 }
 
+TMap<TWeakObjectPtr<const UClass>, TArray<UK2Node_State::FStatePinDesc>> UK2Node_State::StatePinLayouts;
+
 UEdGraphPin* UK2Node_State::GetStateClassPin()
 {
-	for (UEdGraphPin* Pin : Pins)
+	static const FName NAME_StateClassPin(TEXT("StateClass"));
+
+	// Pins keep their order between reconstructs, so the remembered index nearly always hits.
+	if (Pins.IsValidIndex(StateClassPinIndex) && Pins[StateClassPinIndex]->PinName == NAME_StateClassPin)
 	{
-		if (Pin->GetName() == TEXT("StateClass"))
-		{
-			return Pin;
-		}
+		return Pins[StateClassPinIndex];
 	}
 
-	return nullptr;
+	StateClassPinIndex = Pins.IndexOfByPredicate([](const UEdGraphPin* Pin) { return Pin->PinName == NAME_StateClassPin; });
+	return Pins.IsValidIndex(StateClassPinIndex) ? Pins[StateClassPinIndex] : nullptr;
 }
 
 FText UK2Node_State::GetTooltipText() const
@@ -165,10 +169,23 @@ void UK2Node_State::AllocateDefaultPins()
 	StateClassPin->DefaultObject = StateClass;
 
 	// Create input pins for state properties. These should be read and set on state enter.
+	const TWeakObjectPtr<const UClass> StateClassKey(StateClass.Get());
+	const TArray<FStatePinDesc>* CachedLayout = StatePinLayouts.Find(StateClassKey);
+	if (CachedLayout)
+	{
+		for (const FStatePinDesc& PinDesc : *CachedLayout)
+		{
+			UEdGraphPin* Pin = CreatePin(EGPD_Input, PinDesc.PinType, PinDesc.PinName);
+			Pin->PinToolTip = PinDesc.PinToolTip;
+		}
+
+		return;
+	}
+
+	TArray<FStatePinDesc> Layout;
 	for (TFieldIterator<UProperty> PropertyIt(StateClass, EFieldIteratorFlags::IncludeSuper); PropertyIt; ++PropertyIt)
 	{
 		UProperty* Property = *PropertyIt;
-		UClass* PropertyClass = CastChecked<UClass>(Property->GetOuter());
 		const bool bIsDelegate = Property->IsA(UMulticastDelegateProperty::StaticClass());
 		const bool bIsExposedToSpawn = UEdGraphSchema_K2::IsPropertyExposedOnSpawn(Property);
 		const bool bIsSettableExternally = !Property->HasAnyPropertyFlags(CPF_DisableEditOnInstance);
@@ -186,9 +203,20 @@ void UK2Node_State::AllocateDefaultPins()
 			if (Pin != nullptr)
 			{
 				K2Schema->ConstructBasicPinTooltip(*Pin, Property->GetToolTipText(), Pin->PinToolTip);
+				Layout.Add({ Pin->PinName, Pin->PinType, Pin->PinToolTip });
 			}
 		}
 	}
+
+	if (IsValid(StateClass))
+	{
+		StatePinLayouts.Add(StateClassKey, MoveTemp(Layout));
+	}
+}
+
+void UK2Node_State::InvalidatePinLayoutCache()
+{
+	StatePinLayouts.Reset();
 }
 
 void UK2Node_State::ExpandNode(FKismetCompilerContext& CompilerContext, UEdGraph* SourceGraph)
@@ -354,6 +382,21 @@ void UK2Node_State::ExpandNode(FKismetCompilerContext& CompilerContext, UEdGraph
 	BreakAllNodeLinks();
 }
 
+void UK2Node_State::ValidateNodeDuringCompilation(FCompilerResultsLog& MessageLog) const
+{
+	Super::ValidateNodeDuringCompilation(MessageLog);
+
+	// Unreachable nodes are pruned before this runs, UStateGraphCompilerExtension reports those.
+
+	// Only Blueprint states have been analyzed, native ones are assumed to switch on their own.
+	const UState* StateDefaultObject = IsValid(StateClass) ? StateClass->GetDefaultObject<UState>() : nullptr;
+	if (StateDefaultObject && StateDefaultObject->Successors && StateDefaultObject->Successors->States.Num() == 0)
+	{
+		MessageLog.Note(*FText::Format(LOCTEXT("DeadEndStateFmt", "@@ enters {0}, a dead-end state that never switches to another state."),
+			FText::FromString(StateClass->GetName())).ToString(), this);
+	}
+}
+
 void UK2Node_State::ExpandNode_StateCode(class FKismetCompilerContext& CompilerContext, UEdGraph* SourceGraph, const UEdGraphSchema_K2* Schema, bool& bIsErrorFree, UEdGraphPin*& ProxyObjectPin, UEdGraphPin*& LastThenPin)
 {
 	// Cast our UState ProxyClass to our actual state class.
@@ -19,6 +19,9 @@ public:
 
 	UEdGraphPin* GetStateClassPin();
 
+	/** Forget the cached state property pins, they are rebuilt on the next AllocateDefaultPins. */
+	static void InvalidatePinLayoutCache();
+
 	virtual FText GetTooltipText() const override;
 	virtual FText GetNodeTitle(ENodeTitleType::Type TitleType) const override;
 	virtual FText GetMenuCategory() const override;
@@ -28,11 +31,25 @@ public:
 
 	virtual void AllocateDefaultPins() override;
 	virtual void ExpandNode(class FKismetCompilerContext& CompilerContext, UEdGraph* SourceGraph) override;
+	virtual void ValidateNodeDuringCompilation(class FCompilerResultsLog& MessageLog) const override;
 	   
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 #endif // WITH_EDITOR
 
+private:
+	struct FStatePinDesc
+	{
+		FName PinName;
+		FEdGraphPinType PinType;
+		FString PinToolTip;
+	};
+
+	/** Exposed property pins per state class, shared by all State nodes. */
+	static TMap<TWeakObjectPtr<const UClass>, TArray<FStatePinDesc>> StatePinLayouts;
+
+	int32 StateClassPinIndex = INDEX_NONE;
+
 private:
 	void ExpandNode_StateCode(class FKismetCompilerContext& CompilerContext, UEdGraph* SourceGraph, const UEdGraphSchema_K2* Schema, bool& bIsErrorFree, UEdGraphPin*& ProxyObjectPin, UEdGraphPin*& LastThenPin);
 };
@@ -0,0 +1,119 @@
+#include "StateClassIdTableCommandlet.h"
+#include "State.h"
+#include "StateClassIdTable.h"
+#include "StateClassRegistry.h"
+
+#include "AssetRegistryModule.h"
+#include "Engine/Blueprint.h"
+#include "Misc/PackageName.h"
+#include "UObject/UObjectIterator.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStateClassIdTable, Log, All);
+
+namespace StateClassIdTable
+{
+	/** Paths of every native and Blueprint state class, Blueprints from tags so nothing has to load. */
+	TArray<FString> GatherStateClassPaths()
+	{
+		TArray<FString> ClassPaths;
+
+		for (TObjectIterator<UClass> It; It; ++It)
+		{
+			if (It->IsChildOf(UState::StaticClass()) && It->HasAnyClassFlags(CLASS_Native) && !FStateClassRegistry::IsTransientClass(*It))
+			{
+				ClassPaths.Add(It->GetPathName());
+			}
+		}
+
+		IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+		AssetRegistry.SearchAllAssets(true);
+
+		TSet<FName> DerivedClassNames;
+		AssetRegistry.GetDerivedClassNames({ UState::StaticClass()->GetFName() }, TSet<FName>(), DerivedClassNames);
+
+		TArray<FAssetData> Blueprints;
+		AssetRegistry.GetAssetsByClass(UBlueprint::StaticClass()->GetFName(), Blueprints, true);
+		for (const FAssetData& Blueprint : Blueprints)
+		{
+			FString GeneratedClassPath;
+			if (!Blueprint.GetTagValue(FBlueprintTags::GeneratedClassPath, GeneratedClassPath))
+				continue;
+
+			GeneratedClassPath = FPackageName::ExportTextPathToObjectPath(GeneratedClassPath);
+			if (DerivedClassNames.Contains(FName(*FPackageName::ObjectPathToObjectName(GeneratedClassPath))))
+			{
+				ClassPaths.Add(GeneratedClassPath);
+			}
+		}
+
+		ClassPaths.Sort();
+		return ClassPaths;
+	}
+}
+
+UStateClassIdTableCommandlet::UStateClassIdTableCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UStateClassIdTableCommandlet::Main(const FString& Params)
+{
+	using namespace StateClassIdTable;
+
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	const bool bVerify = Switches.Contains(TEXT("Verify"));
+
+	UStateClassIdTable* Table = GetMutableDefault<UStateClassIdTable>();
+
+	TSet<FString> KnownClassPaths;
+	for (const FSoftClassPath& ClassPath : Table->StateClasses)
+	{
+		KnownClassPaths.Add(ClassPath.ToString());
+	}
+
+	TArray<FString> MissingClassPaths;
+	for (const FString& ClassPath : GatherStateClassPaths())
+	{
+		if (!KnownClassPaths.Contains(ClassPath))
+		{
+			MissingClassPaths.Add(ClassPath);
+			UE_LOG(LogStateClassIdTable, Display, TEXT("%s %s"), bVerify ? TEXT("Missing") : TEXT("Adding"), *ClassPath);
+		}
+	}
+
+	if (bVerify)
+	{
+		if (MissingClassPaths.Num() > 0)
+		{
+			UE_LOG(LogStateClassIdTable, Error, TEXT("%d state classes are missing from the id table, run -run=StateClassIdTable and submit DefaultStateMachineEx.ini."), MissingClassPaths.Num());
+			return 1;
+		}
+
+		UE_LOG(LogStateClassIdTable, Display, TEXT("State class id table is up to date, %d classes."), Table->StateClasses.Num());
+		return 0;
+	}
+
+	if (MissingClassPaths.Num() == 0)
+	{
+		UE_LOG(LogStateClassIdTable, Display, TEXT("State class id table is up to date, %d classes."), Table->StateClasses.Num());
+		return 0;
+	}
+
+	// Only ever append, ids already in shipped builds must not move.
+	for (const FString& ClassPath : MissingClassPaths)
+	{
+		Table->StateClasses.Add(FSoftClassPath(ClassPath));
+	}
+	Table->UpdateDefaultConfigFile();
+
+	UE_LOG(LogStateClassIdTable, Display, TEXT("Added %d state classes, the id table now has %d."), MissingClassPaths.Num(), Table->StateClasses.Num());
+	return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StateClassIdTableCommandlet.generated.h"
+
+/**
+ * Appends every native and Blueprint state class missing from the state class id table and saves it to
+ * Config/DefaultStateMachineEx.ini. Existing entries are never moved or removed.
+ *
+ * UE4Editor-Cmd <Project> -run=StateClassIdTable [-Verify] -nullrhi -unattended
+ *
+ * -Verify only reports missing classes and fails if there are any, for the build machine.
+ */
+UCLASS()
+class UStateClassIdTableCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStateClassIdTableCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,149 @@
+#include "StateGraphAnalysis.h"
+#include "K2Node_State.h"
+#include "State.h"
+
+#include "EdGraphSchema_K2.h"
+#include "Engine/Blueprint.h"
+#include "Kismet2/BlueprintEditorUtils.h"
+
+namespace StateGraphAnalysis
+{
+	bool HasExecPin(const UEdGraphNode* Node, EEdGraphPinDirection Direction)
+	{
+		return Node->Pins.ContainsByPredicate([Direction](const UEdGraphPin* Pin)
+		{
+			return Pin->Direction == Direction && Pin->PinType.PinCategory == UEdGraphSchema_K2::PC_Exec;
+		});
+	}
+}
+
+void FStateGraphAnalysis::GatherSuccessors(const UBlueprint* Blueprint, TArray<UClass*>& OutSuccessors)
+{
+	TArray<UK2Node_State*> StateNodes;
+	FBlueprintEditorUtils::GetAllNodesOfClass<UK2Node_State>(Blueprint, StateNodes);
+
+	for (const UK2Node_State* StateNode : StateNodes)
+	{
+		if (IsValid(StateNode->StateClass))
+		{
+			OutSuccessors.AddUnique(StateNode->StateClass);
+		}
+	}
+
+	// Sort so the saved table does not change with node order.
+	OutSuccessors.Sort([](const UClass& A, const UClass& B) { return A.GetPathName() < B.GetPathName(); });
+}
+
+void FStateGraphAnalysis::UpdateSuccessors(UState* DefaultObject)
+{
+	UClass* StateClass = DefaultObject->GetClass();
+	const UBlueprint* Blueprint = Cast<UBlueprint>(StateClass->ClassGeneratedBy);
+	if (!Blueprint)
+		return;
+
+	TArray<UClass*> SuccessorClasses;
+	GatherSuccessors(Blueprint, SuccessorClasses);
+
+	TArray<TSoftClassPtr<UState>> SuccessorStates;
+	for (UClass* SuccessorClass : SuccessorClasses)
+	{
+		SuccessorStates.Add(SuccessorClass);
+	}
+
+	// A child Blueprint runs its parent's graphs as well. Native parents are not analyzed.
+	const UState* ParentDefaultObject = Cast<UState>(StateClass->GetSuperClass()->GetDefaultObject());
+	if (ParentDefaultObject && ParentDefaultObject->Successors)
+	{
+		for (const TSoftClassPtr<UState>& ParentSuccessor : ParentDefaultObject->Successors->States)
+		{
+			SuccessorStates.AddUnique(ParentSuccessor);
+		}
+
+		// Sort so the saved table does not depend on which side a successor came from.
+		SuccessorStates.Sort([](const TSoftClassPtr<UState>& A, const TSoftClassPtr<UState>& B) { return A.ToString() < B.ToString(); });
+	}
+
+	// The table is outered to the class so it is saved with the Blueprint and survives recompiles.
+	static const FName NAME_StateSuccessors(TEXT("StateSuccessors"));
+	UStateSuccessors* Successors = FindObjectFast<UStateSuccessors>(StateClass, NAME_StateSuccessors);
+	if (!Successors)
+	{
+		Successors = NewObject<UStateSuccessors>(StateClass, NAME_StateSuccessors);
+	}
+
+	Successors->States = MoveTemp(SuccessorStates);
+
+	DefaultObject->Successors = Successors;
+}
+
+bool FStateGraphAnalysis::HasStateNodes(const UBlueprint* Blueprint)
+{
+	TArray<UEdGraph*> Graphs;
+	Blueprint->GetAllGraphs(Graphs);
+
+	for (const UEdGraph* Graph : Graphs)
+	{
+		for (const UEdGraphNode* Node : Graph->Nodes)
+		{
+			if (Cast<UK2Node_State>(Node))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void FStateGraphAnalysis::GatherUnreachableStateNodes(const UBlueprint* Blueprint, TArray<UK2Node_State*>& OutStateNodes)
+{
+	using namespace StateGraphAnalysis;
+
+	TArray<UEdGraph*> Graphs;
+	Blueprint->GetAllGraphs(Graphs);
+
+	// Flood forward along exec wires from every node that starts execution.
+	TSet<const UEdGraphNode*> Reached;
+	TArray<const UEdGraphNode*> Pending;
+	for (const UEdGraph* Graph : Graphs)
+	{
+		for (const UEdGraphNode* Node : Graph->Nodes)
+		{
+			if (Node && HasExecPin(Node, EGPD_Output) && !HasExecPin(Node, EGPD_Input))
+			{
+				Reached.Add(Node);
+				Pending.Add(Node);
+			}
+		}
+	}
+
+	while (Pending.Num() > 0)
+	{
+		const UEdGraphNode* Node = Pending.Pop(false);
+		for (const UEdGraphPin* Pin : Node->Pins)
+		{
+			if (Pin->Direction != EGPD_Output || Pin->PinType.PinCategory != UEdGraphSchema_K2::PC_Exec)
+				continue;
+
+			for (const UEdGraphPin* LinkedPin : Pin->LinkedTo)
+			{
+				const UEdGraphNode* LinkedNode = LinkedPin->GetOwningNode();
+				if (!Reached.Contains(LinkedNode))
+				{
+					Reached.Add(LinkedNode);
+					Pending.Add(LinkedNode);
+				}
+			}
+		}
+	}
+
+	for (const UEdGraph* Graph : Graphs)
+	{
+		for (UEdGraphNode* Node : Graph->Nodes)
+		{
+			UK2Node_State* StateNode = Cast<UK2Node_State>(Node);
+			if (StateNode && !Reached.Contains(StateNode))
+			{
+				OutStateNodes.Add(StateNode);
+			}
+		}
+	}
+}
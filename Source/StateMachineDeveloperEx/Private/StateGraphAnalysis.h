@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UBlueprint;
+class UState;
+class UK2Node_State;
+
+struct FStateGraphAnalysis
+{
+	/** Unique state classes targeted by the State nodes of Blueprint, sorted by path. */
+	static void GatherSuccessors(const UBlueprint* Blueprint, TArray<UClass*>& OutSuccessors);
+
+	/**
+	 * Store the gathered successors on a freshly compiled state class default object, together with the ones inherited
+	 * from a parent state Blueprint.
+	 */
+	static void UpdateSuccessors(UState* DefaultObject);
+
+	/** Whether any graph of Blueprint has a State node, stops at the first one. */
+	static bool HasStateNodes(const UBlueprint* Blueprint);
+
+	/**
+	 * State nodes of Blueprint that no event, function entry or tunnel entry leads to through exec wires. Macro and
+	 * collapsed graphs count their own entry as reachable.
+	 */
+	static void GatherUnreachableStateNodes(const UBlueprint* Blueprint, TArray<UK2Node_State*>& OutStateNodes);
+};
@@ -0,0 +1,211 @@
+#include "StateGraphBenchmarkCommandlet.h"
+#include "K2Node_State.h"
+#include "State.h"
+
+#include "Dom/JsonObject.h"
+#include "EdGraphSchema_K2.h"
+#include "Engine/Blueprint.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "K2Node_CustomEvent.h"
+#include "K2Node_ExecutionSequence.h"
+#include "Kismet2/BlueprintEditorUtils.h"
+#include "Kismet2/KismetEditorUtilities.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStateGraphBenchmark, Log, All);
+
+namespace StateGraphBenchmark
+{
+	double ReconstructStateNodes(const TArray<UK2Node_State*>& StateNodes)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for (UK2Node_State* StateNode : StateNodes)
+		{
+			StateNode->ReconstructNode();
+		}
+		return FPlatformTime::Seconds() - StartTime;
+	}
+
+	UBlueprint* CreateStateBlueprint(const FString& Name)
+	{
+		UPackage* Package = CreatePackage(nullptr, *(TEXT("/Temp/StateGraphBenchmark/") + Name));
+		return FKismetEditorUtilities::CreateBlueprint(UState::StaticClass(), Package, *Name, BPTYPE_Normal, UBlueprint::StaticClass(), UBlueprintGeneratedClass::StaticClass());
+	}
+
+	/**
+	 * A state Blueprint whose event graph runs NumStateNodes State nodes from one custom event, all targeting a state
+	 * class with NumVariables exposed variables. Same parameters, same graph, so nightly numbers need no project content.
+	 */
+	UBlueprint* CreateSyntheticBlueprint(int32 NumStateNodes, int32 NumVariables)
+	{
+		static const FName PinCategories[] = { UEdGraphSchema_K2::PC_Float, UEdGraphSchema_K2::PC_Int, UEdGraphSchema_K2::PC_Boolean, UEdGraphSchema_K2::PC_Name };
+
+		UBlueprint* TargetBlueprint = CreateStateBlueprint(TEXT("SyntheticTargetState"));
+		for (int32 Index = 0; Index < NumVariables; ++Index)
+		{
+			const FName VariableName(*FString::Printf(TEXT("Variable%d"), Index));
+
+			FEdGraphPinType PinType;
+			PinType.PinCategory = PinCategories[Index % UE_ARRAY_COUNT(PinCategories)];
+			FBlueprintEditorUtils::AddMemberVariable(TargetBlueprint, VariableName, PinType);
+			FBlueprintEditorUtils::SetBlueprintOnlyEditableFlag(TargetBlueprint, VariableName, false);
+			FBlueprintEditorUtils::SetBlueprintVariableMetaData(TargetBlueprint, VariableName, nullptr, FBlueprintMetadata::MD_ExposeOnSpawn, TEXT("true"));
+		}
+		FKismetEditorUtilities::CompileBlueprint(TargetBlueprint, EBlueprintCompileOptions::SkipGarbageCollection);
+
+		UBlueprint* Blueprint = CreateStateBlueprint(FString::Printf(TEXT("SyntheticStateGraph_%d"), NumStateNodes));
+		UEdGraph* Graph = FBlueprintEditorUtils::FindEventGraph(Blueprint);
+		const UEdGraphSchema_K2* Schema = GetDefault<UEdGraphSchema_K2>();
+
+		// Every State node hangs off one sequence, so none of them is pruned as unreachable.
+		UK2Node_CustomEvent* EntryNode = NewObject<UK2Node_CustomEvent>(Graph);
+		EntryNode->CustomFunctionName = TEXT("SyntheticEntry");
+		EntryNode->CreateNewGuid();
+		EntryNode->PostPlacedNewNode();
+		EntryNode->AllocateDefaultPins();
+		Graph->AddNode(EntryNode, false, false);
+
+		UK2Node_ExecutionSequence* SequenceNode = NewObject<UK2Node_ExecutionSequence>(Graph);
+		SequenceNode->CreateNewGuid();
+		SequenceNode->PostPlacedNewNode();
+		SequenceNode->AllocateDefaultPins();
+		Graph->AddNode(SequenceNode, false, false);
+		for (int32 Index = 2; Index < NumStateNodes; ++Index)
+		{
+			SequenceNode->AddInputPin();
+		}
+		Schema->TryCreateConnection(EntryNode->FindPinChecked(UEdGraphSchema_K2::PN_Then), SequenceNode->GetExecPin());
+
+		for (int32 Index = 0; Index < NumStateNodes; ++Index)
+		{
+			UK2Node_State* StateNode = NewObject<UK2Node_State>(Graph);
+			StateNode->StateClass = TargetBlueprint->GeneratedClass.Get();
+			StateNode->CreateNewGuid();
+			StateNode->PostPlacedNewNode();
+			StateNode->AllocateDefaultPins();
+			StateNode->NodePosX = 400;
+			StateNode->NodePosY = Index * 200;
+			Graph->AddNode(StateNode, false, false);
+
+			Schema->TryCreateConnection(SequenceNode->GetThenPinGivenIndex(Index), StateNode->GetExecPin());
+		}
+
+		FKismetEditorUtilities::CompileBlueprint(Blueprint, EBlueprintCompileOptions::SkipGarbageCollection);
+		return Blueprint;
+	}
+
+	TSharedRef<FJsonObject> BenchmarkBlueprint(UBlueprint* Blueprint, int32 NumIterations)
+	{
+		TArray<UK2Node_State*> StateNodes;
+		FBlueprintEditorUtils::GetAllNodesOfClass<UK2Node_State>(Blueprint, StateNodes);
+
+		double ColdReconstructTime = 0.0;
+		double WarmReconstructTime = 0.0;
+		double CompileTime = 0.0;
+
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			UK2Node_State::InvalidatePinLayoutCache();
+			ColdReconstructTime += ReconstructStateNodes(StateNodes);
+			WarmReconstructTime += ReconstructStateNodes(StateNodes);
+
+			const double CompileStartTime = FPlatformTime::Seconds();
+			FKismetEditorUtilities::CompileBlueprint(Blueprint, EBlueprintCompileOptions::SkipGarbageCollection);
+			CompileTime += FPlatformTime::Seconds() - CompileStartTime;
+
+			// Compiling reconstructs and may replace nodes, fetch them again.
+			StateNodes.Reset();
+			FBlueprintEditorUtils::GetAllNodesOfClass<UK2Node_State>(Blueprint, StateNodes);
+		}
+
+		TSharedRef<FJsonObject> BlueprintObject = MakeShared<FJsonObject>();
+		BlueprintObject->SetNumberField(TEXT("stateNodes"), StateNodes.Num());
+		BlueprintObject->SetNumberField(TEXT("coldReconstructSeconds"), ColdReconstructTime / NumIterations);
+		BlueprintObject->SetNumberField(TEXT("warmReconstructSeconds"), WarmReconstructTime / NumIterations);
+		BlueprintObject->SetNumberField(TEXT("compileSeconds"), CompileTime / NumIterations);
+
+		UE_LOG(LogStateGraphBenchmark, Display, TEXT("%s: %d State nodes, reconstruct %.2f ms cold / %.2f ms warm, compile %.2f ms."),
+			*Blueprint->GetPathName(), StateNodes.Num(), ColdReconstructTime * 1000.0 / NumIterations, WarmReconstructTime * 1000.0 / NumIterations, CompileTime * 1000.0 / NumIterations);
+
+		return BlueprintObject;
+	}
+}
+
+UStateGraphBenchmarkCommandlet::UStateGraphBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UStateGraphBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace StateGraphBenchmark;
+
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	const int32 NumIterations = FMath::Max(1, ParamValues.Contains(TEXT("Iterations")) ? FCString::Atoi(*ParamValues[TEXT("Iterations")]) : 5);
+	const FString ReportPath = ParamValues.Contains(TEXT("Report"))
+		? ParamValues[TEXT("Report")]
+		: FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("StateMachineEx"), TEXT("GraphBenchmarkReport.json"));
+
+	const int32 NumSyntheticNodes = ParamValues.Contains(TEXT("Synthetic")) ? FCString::Atoi(*ParamValues[TEXT("Synthetic")]) : 0;
+	const int32 NumSyntheticVariables = ParamValues.Contains(TEXT("Variables")) ? FMath::Max(0, FCString::Atoi(*ParamValues[TEXT("Variables")])) : 8;
+
+	TArray<FString> BlueprintPaths;
+	ParamValues.FindRef(TEXT("Blueprints")).ParseIntoArray(BlueprintPaths, TEXT("+"));
+	if (BlueprintPaths.Num() == 0 && NumSyntheticNodes <= 0)
+	{
+		UE_LOG(LogStateGraphBenchmark, Error, TEXT("No Blueprints given, use -Blueprints=<Path>[+<Path>...] or -Synthetic=<NumStateNodes>."));
+		return 1;
+	}
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetNumberField(TEXT("iterations"), NumIterations);
+
+	BlueprintPaths.Sort();
+
+	TSharedRef<FJsonObject> BlueprintsObject = MakeShared<FJsonObject>();
+	for (const FString& BlueprintPath : BlueprintPaths)
+	{
+		UBlueprint* Blueprint = LoadObject<UBlueprint>(nullptr, *BlueprintPath);
+		if (!Blueprint)
+		{
+			UE_LOG(LogStateGraphBenchmark, Error, TEXT("Could not load Blueprint %s."), *BlueprintPath);
+			return 1;
+		}
+
+		BlueprintsObject->SetObjectField(BlueprintPath, BenchmarkBlueprint(Blueprint, NumIterations));
+	}
+
+	if (NumSyntheticNodes > 0)
+	{
+		UBlueprint* Blueprint = CreateSyntheticBlueprint(NumSyntheticNodes, NumSyntheticVariables);
+
+		TSharedRef<FJsonObject> SyntheticObject = BenchmarkBlueprint(Blueprint, NumIterations);
+		SyntheticObject->SetNumberField(TEXT("stateVariables"), NumSyntheticVariables);
+		Report->SetObjectField(TEXT("synthetic"), SyntheticObject);
+	}
+
+	Report->SetObjectField(TEXT("blueprints"), BlueprintsObject);
+
+	FString ReportString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	if (!FFileHelper::SaveStringToFile(ReportString, *ReportPath))
+	{
+		UE_LOG(LogStateGraphBenchmark, Error, TEXT("Could not write report to %s."), *ReportPath);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StateGraphBenchmarkCommandlet.generated.h"
+
+/**
+ * Times State node reconstruction and Blueprint compilation and writes a JSON report.
+ *
+ * UE4Editor-Cmd <Project> -run=StateGraphBenchmark -Blueprints=/Game/Flow/BP_Flow[+...] [-Iterations=5] [-Report=<path>] -nullrhi -unattended
+ *
+ * -Synthetic=<NumStateNodes> [-Variables=8] also builds and times a generated graph of that size, no content needed.
+ */
+UCLASS()
+class UStateGraphBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStateGraphBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,26 @@
+#include "StateGraphCompilerExtension.h"
+#include "StateGraphAnalysis.h"
+#include "K2Node_State.h"
+
+#include "KismetCompiler.h"
+#include "Kismet2/CompilerResultsLog.h"
+
+#define LOCTEXT_NAMESPACE "FStateMachineDeveloperExModule"
+
+void UStateGraphCompilerExtension::ProcessBlueprintCompiled(const FKismetCompilerContext& CompilationContext, const FBlueprintCompiledData& Data)
+{
+	// Registered for every Blueprint, most of which have no State node to check.
+	if (!FStateGraphAnalysis::HasStateNodes(CompilationContext.Blueprint))
+		return;
+
+	// Walk the source graphs, the compiler's copies no longer contain the pruned nodes.
+	TArray<UK2Node_State*> UnreachableStateNodes;
+	FStateGraphAnalysis::GatherUnreachableStateNodes(CompilationContext.Blueprint, UnreachableStateNodes);
+
+	for (const UK2Node_State* StateNode : UnreachableStateNodes)
+	{
+		CompilationContext.MessageLog.Warning(*LOCTEXT("UnreachableState", "@@ is unreachable, no event or function entry leads to it.").ToString(), StateNode);
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
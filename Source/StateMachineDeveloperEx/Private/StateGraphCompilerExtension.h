@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlueprintCompilerExtension.h"
+#include "StateGraphCompilerExtension.generated.h"
+
+/** Reports State nodes that can never run, which the compiler prunes without a word. */
+UCLASS()
+class UStateGraphCompilerExtension : public UBlueprintCompilerExtension
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void ProcessBlueprintCompiled(const FKismetCompilerContext& CompilationContext, const FBlueprintCompiledData& Data) override;
+};
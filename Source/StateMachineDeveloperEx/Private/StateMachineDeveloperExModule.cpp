@@ -1,13 +1,58 @@
 #include "StateMachineDeveloperExModule.h"
+#include "StateGraphAnalysis.h"
+#include "StateGraphCompilerExtension.h"
+#include "K2Node_State.h"
+#include "State.h"
+
+#include "BlueprintCompilationManager.h"
+#include "Editor.h"
+#include "Misc/CoreDelegates.h"
+#include "UObject/UObjectGlobals.h"
 
 #define LOCTEXT_NAMESPACE "FStateMachineDeveloperExModule"
 
 void FStateMachineDeveloperExModule::StartupModule()
 {
+#if WITH_EDITOR
+	UState::OnStateClassCompiled.BindLambda([](UState* DefaultObject)
+	{
+		FStateGraphAnalysis::UpdateSuccessors(DefaultObject);
+
+		// Child state classes inherit the recompiled properties, so drop every cached layout.
+		UK2Node_State::InvalidatePinLayoutCache();
+	});
+
+	FBlueprintCompilationManager::RegisterCompilerExtension(UBlueprint::StaticClass(), GetMutableDefault<UStateGraphCompilerExtension>());
+
+	// Nodes of dependent Blueprints are reconstructed during the compile, so the cache has to go before it starts.
+	FCoreDelegates::OnPostEngineInit.AddLambda([this]()
+	{
+		if (GEditor)
+		{
+			BlueprintPreCompileHandle = GEditor->OnBlueprintPreCompile().AddLambda([](UBlueprint*)
+			{
+				UK2Node_State::InvalidatePinLayoutCache();
+			});
+		}
+	});
+
+	ReloadCompleteHandle = FCoreUObjectDelegates::ReloadCompleteDelegate.AddLambda([](EReloadCompleteReason)
+	{
+		UK2Node_State::InvalidatePinLayoutCache();
+	});
+#endif // WITH_EDITOR
 }
 
 void FStateMachineDeveloperExModule::ShutdownModule()
 {
+#if WITH_EDITOR
+	UState::OnStateClassCompiled.Unbind();
+	FCoreUObjectDelegates::ReloadCompleteDelegate.Remove(ReloadCompleteHandle);
+	if (GEditor)
+	{
+		GEditor->OnBlueprintPreCompile().Remove(BlueprintPreCompileHandle);
+	}
+#endif // WITH_EDITOR
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,321 @@
+#include "StateMachineSimulationCommandlet.h"
+#include "StateMachine.h"
+#include "State.h"
+#include "StateClassRegistry.h"
+#include "StateMachineSubsystem.h"
+
+#include "Dom/JsonObject.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectArray.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStateMachineSimulation, Log, All);
+
+namespace StateMachineSimulation
+{
+	/** Counts UObject creations while the simulation runs. */
+	class FObjectCreateCounter : public FUObjectArray::FUObjectCreateListener
+	{
+	public:
+		int32 NumObjects = 0;
+		int32 NumStates = 0;
+
+		virtual void NotifyUObjectCreated(const UObjectBase* Object, int32 Index) override
+		{
+			++NumObjects;
+
+			const UClass* Class = Object->GetClass();
+			if (Class && Class->IsChildOf(UState::StaticClass()))
+			{
+				++NumStates;
+			}
+		}
+
+		virtual void OnUObjectArrayShutdown() override
+		{
+		}
+	};
+
+	struct FStateTiming
+	{
+		uint64 Cycles = 0;
+		int32 NumTicks = 0;
+	};
+
+	FString GetStateName(FStateClassId Id)
+	{
+		return Id == FStateClassRegistry::InvalidId ? TEXT("<none>") : FStateClassRegistry::Get().GetClassName(Id).ToString();
+	}
+}
+
+UStateMachineSimulationCommandlet::UStateMachineSimulationCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UStateMachineSimulationCommandlet::Main(const FString& Params)
+{
+	using namespace StateMachineSimulation;
+
+	TArray<FString> Tokens;
+	TArray<FString> Switches;
+	TMap<FString, FString> ParamValues;
+	ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+	const FString MachinesParam = ParamValues.FindRef(TEXT("Machines"));
+	const FString MapName = ParamValues.FindRef(TEXT("Map"));
+	const int32 NumInstances = FMath::Max(1, ParamValues.Contains(TEXT("Instances")) ? FCString::Atoi(*ParamValues[TEXT("Instances")]) : 100);
+	const float SimulatedSeconds = ParamValues.Contains(TEXT("Seconds")) ? FCString::Atof(*ParamValues[TEXT("Seconds")]) : 60.0f;
+	const float StepSeconds = FMath::Max(0.001f, ParamValues.Contains(TEXT("Step")) ? FCString::Atof(*ParamValues[TEXT("Step")]) : 1.0f / 30.0f);
+	const int32 MemorySampleSteps = FMath::Max(1, ParamValues.Contains(TEXT("MemorySampleSteps")) ? FCString::Atoi(*ParamValues[TEXT("MemorySampleSteps")]) : 30);
+	const FString ReportPath = ParamValues.Contains(TEXT("Report"))
+		? ParamValues[TEXT("Report")]
+		: FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("StateMachineEx"), TEXT("SimulationReport.json"));
+
+	TArray<FString> MachineClassPaths;
+	MachinesParam.ParseIntoArray(MachineClassPaths, TEXT("+"));
+	if (MachineClassPaths.Num() == 0 && MapName.IsEmpty())
+	{
+		UE_LOG(LogStateMachineSimulation, Error, TEXT("Nothing to simulate, use -Machines=<ClassPath>[+<ClassPath>...] and/or -Map=<MapPath>."));
+		return 1;
+	}
+
+	TArray<UClass*> MachineClasses;
+	for (const FString& ClassPath : MachineClassPaths)
+	{
+		UClass* MachineClass = LoadClass<UStateMachine>(nullptr, *ClassPath);
+		if (!MachineClass)
+		{
+			UE_LOG(LogStateMachineSimulation, Error, TEXT("Could not load state machine class %s."), *ClassPath);
+			return 1;
+		}
+
+		MachineClasses.Add(MachineClass);
+	}
+
+	UWorld* World = CreateSimulationWorld(MapName);
+	if (!World)
+	{
+		UE_LOG(LogStateMachineSimulation, Error, TEXT("Could not create a world from %s."), *MapName);
+		return 1;
+	}
+
+	// Machines the map's actors registered during BeginPlay are ticked by their subsystem, the way the game does.
+	UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(World);
+	TArray<UStateMachine*> MapStateMachines;
+	if (Subsystem)
+	{
+		Subsystem->GetRegisteredStateMachines(MapStateMachines);
+	}
+
+	if (MachineClasses.Num() == 0 && MapStateMachines.Num() == 0)
+	{
+		UE_LOG(LogStateMachineSimulation, Error, TEXT("%s registers no state machines, nothing to simulate."), *MapName);
+		DestroySimulationWorld(World);
+		return 1;
+	}
+
+	// Keep our machines referenced, the commandlet itself is not rooted.
+	AddToRoot();
+
+	FObjectCreateCounter CreateCounter;
+	GUObjectArray.AddUObjectCreateListener(&CreateCounter);
+
+	TMap<FString, int32> TransitionCounts;
+	const FDelegateHandle StateEnteredHandle = UStateMachine::OnStateEntered.AddLambda([&TransitionCounts](UStateMachine* StateMachine, UState* State)
+	{
+		const FString Transition = GetStateName(StateMachine->GetPreviousStateId()) + TEXT(" -> ") + GetStateName(State->StateId);
+		++TransitionCounts.FindOrAdd(Transition);
+	});
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (UClass* MachineClass : MachineClasses)
+	{
+		for (int32 Index = 0; Index < NumInstances; ++Index)
+		{
+			UStateMachine* StateMachine = NewObject<UStateMachine>(World, MachineClass);
+			StateMachine->Reset();
+			StateMachines.Add(StateMachine);
+		}
+	}
+
+	TMap<FStateClassId, FStateTiming> StateTimings;
+	uint64 SubsystemTickCycles = 0;
+	uint64 PeakUsedPhysical = 0;
+
+	const int32 NumSteps = FMath::CeilToInt(SimulatedSeconds / StepSeconds);
+	for (int32 Step = 0; Step < NumSteps; ++Step)
+	{
+		for (UStateMachine* StateMachine : StateMachines)
+		{
+			// Attribute the tick to the state that does the work, which is the pending one if the machine is between states.
+			// A tick that switches leaves no current state behind, so this has to be read up front.
+			const UState* TickedState = IsValid(StateMachine->CurrentState) ? StateMachine->CurrentState : StateMachine->NextState;
+			const FStateClassId TickedStateId = IsValid(TickedState) ? TickedState->StateId : FStateClassRegistry::InvalidId;
+
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			StateMachine->Tick(StepSeconds);
+			const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+
+			FStateTiming& Timing = StateTimings.FindOrAdd(TickedStateId);
+			Timing.Cycles += Cycles;
+			++Timing.NumTicks;
+		}
+
+		if (Subsystem && MapStateMachines.Num() > 0)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Subsystem->Tick(StepSeconds);
+			SubsystemTickCycles += FPlatformTime::Cycles64() - StartCycles;
+		}
+
+		// Reading the platform stats is a syscall on most platforms, keep it out of every step.
+		if (Step % MemorySampleSteps == 0 || Step == NumSteps - 1)
+		{
+			PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+		}
+	}
+
+	const double SimulationTime = FPlatformTime::Seconds() - StartTime;
+
+	UStateMachine::OnStateEntered.Remove(StateEnteredHandle);
+
+	const double TeardownStartTime = FPlatformTime::Seconds();
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		StateMachine->Shutdown();
+	}
+	if (Subsystem && MapStateMachines.Num() > 0)
+	{
+		Subsystem->ShutdownAll(true, 0);
+	}
+	const double TeardownTime = FPlatformTime::Seconds() - TeardownStartTime;
+
+	GUObjectArray.RemoveUObjectCreateListener(&CreateCounter);
+
+	// Build the report with sorted keys so reports from two builds diff cleanly.
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+
+	TArray<TSharedPtr<FJsonValue>> MachineValues;
+	for (const FString& ClassPath : MachineClassPaths)
+	{
+		MachineValues.Add(MakeShared<FJsonValueString>(ClassPath));
+	}
+	Report->SetArrayField(TEXT("machines"), MachineValues);
+	Report->SetStringField(TEXT("map"), MapName);
+	Report->SetNumberField(TEXT("mapMachines"), MapStateMachines.Num());
+	Report->SetNumberField(TEXT("instancesPerMachine"), NumInstances);
+	Report->SetNumberField(TEXT("simulatedSeconds"), SimulatedSeconds);
+	Report->SetNumberField(TEXT("stepSeconds"), StepSeconds);
+	Report->SetNumberField(TEXT("steps"), NumSteps);
+	Report->SetNumberField(TEXT("simulationWallSeconds"), SimulationTime);
+	Report->SetNumberField(TEXT("teardownWallSeconds"), TeardownTime);
+	Report->SetNumberField(TEXT("mapMachineTickSeconds"), FPlatformTime::ToSeconds64(SubsystemTickCycles));
+
+	TransitionCounts.KeySort(TLess<FString>());
+	TSharedRef<FJsonObject> TransitionsObject = MakeShared<FJsonObject>();
+	for (const TPair<FString, int32>& Pair : TransitionCounts)
+	{
+		TransitionsObject->SetNumberField(Pair.Key, Pair.Value);
+	}
+	Report->SetObjectField(TEXT("transitions"), TransitionsObject);
+
+	TMap<FString, FStateTiming> StateTimingsByName;
+	for (const TPair<FStateClassId, FStateTiming>& Pair : StateTimings)
+	{
+		StateTimingsByName.Add(GetStateName(Pair.Key), Pair.Value);
+	}
+	StateTimingsByName.KeySort(TLess<FString>());
+
+	TSharedRef<FJsonObject> StatesObject = MakeShared<FJsonObject>();
+	for (const TPair<FString, FStateTiming>& Pair : StateTimingsByName)
+	{
+		TSharedRef<FJsonObject> StateObject = MakeShared<FJsonObject>();
+		StateObject->SetNumberField(TEXT("seconds"), FPlatformTime::ToSeconds64(Pair.Value.Cycles));
+		StateObject->SetNumberField(TEXT("ticks"), Pair.Value.NumTicks);
+		StatesObject->SetObjectField(Pair.Key, StateObject);
+	}
+	Report->SetObjectField(TEXT("states"), StatesObject);
+
+	TSharedRef<FJsonObject> MemoryObject = MakeShared<FJsonObject>();
+	MemoryObject->SetNumberField(TEXT("objectsCreated"), CreateCounter.NumObjects);
+	MemoryObject->SetNumberField(TEXT("statesCreated"), CreateCounter.NumStates);
+	MemoryObject->SetNumberField(TEXT("peakUsedPhysicalBytes"), static_cast<double>(PeakUsedPhysical));
+	MemoryObject->SetNumberField(TEXT("processPeakUsedPhysicalBytes"), static_cast<double>(FPlatformMemory::GetStats().PeakUsedPhysical));
+	Report->SetObjectField(TEXT("memory"), MemoryObject);
+
+	FString ReportString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	const int32 NumStateMachines = StateMachines.Num() + MapStateMachines.Num();
+	MapStateMachines.Empty();
+	StateMachines.Empty();
+	RemoveFromRoot();
+
+	DestroySimulationWorld(World);
+
+	if (!FFileHelper::SaveStringToFile(ReportString, *ReportPath))
+	{
+		UE_LOG(LogStateMachineSimulation, Error, TEXT("Could not write report to %s."), *ReportPath);
+		return 1;
+	}
+
+	UE_LOG(LogStateMachineSimulation, Display, TEXT("Simulated %d state machines for %.1fs in %.2fs, report written to %s."),
+		NumStateMachines, SimulatedSeconds, SimulationTime, *ReportPath);
+
+	return 0;
+}
+
+UWorld* UStateMachineSimulationCommandlet::CreateSimulationWorld(const FString& MapName)
+{
+	if (MapName.IsEmpty())
+	{
+		return UWorld::CreateWorld(EWorldType::Game, false);
+	}
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+		return nullptr;
+
+	World->AddToRoot();
+	World->WorldType = EWorldType::Game;
+
+	if (!World->bIsWorldInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.RequiresHitProxies(false)
+			.CreatePhysicsScene(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.SetTransactional(false));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	// Bring the actors up so components that own state machines create and register them.
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	return World;
+}
+
+void UStateMachineSimulationCommandlet::DestroySimulationWorld(UWorld* World)
+{
+	// Both CreateWorld and CreateSimulationWorld root the world, release it so the commandlet leaves nothing behind.
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
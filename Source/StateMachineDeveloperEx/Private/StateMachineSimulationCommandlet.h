@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StateMachineSimulationCommandlet.generated.h"
+
+/**
+ * Drives state machines headless and writes a JSON report.
+ *
+ * UE4Editor-Cmd <Project> -run=StateMachineSimulation [-Machines=/Game/AI/BP_Machine.BP_Machine_C[+...]]
+ *     [-Map=/Game/Maps/Test] [-Instances=100] [-Seconds=60] [-Step=0.0333] [-MemorySampleSteps=30] [-Report=<path>]
+ *     -nullrhi -unattended
+ *
+ * -Machines spawns Instances of each class and times every tick per state. -Map begins play on the map and ticks the
+ * machines its actors register through their subsystem. Either or both may be given.
+ */
+UCLASS()
+class UStateMachineSimulationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStateMachineSimulationCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	class UWorld* CreateSimulationWorld(const FString& MapName);
+	void DestroySimulationWorld(class UWorld* World);
+
+private:
+	UPROPERTY(Transient)
+	TArray<class UStateMachine*> StateMachines;
+};
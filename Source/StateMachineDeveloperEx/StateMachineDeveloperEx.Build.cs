@@ -19,6 +19,8 @@ public class StateMachineDeveloperEx : ModuleRules
 			"CoreUObject",
 			"Engine",
             "StateMachineEx",
+			"Json",
+			"AssetRegistry",
         });
 
         if (Target.bBuildEditor)
@@ -0,0 +1,115 @@
+#include "GameplayDebuggerCategory_StateMachine.h"
+
+#if WITH_GAMEPLAY_DEBUGGER
+
+#include "StateMachineDebugger.h"
+#include "StateMachine.h"
+#include "StateMachineExBlueprintFunctionLibrary.h"
+
+#include "Containers/Ticker.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+namespace StateMachineGameplayDebugger
+{
+	const float NearbyRadius = 2000.0f;
+	const int32 MaxNearbyStateMachines = 8;
+
+	/** Seconds without CollectData after which the category counts as closed. */
+	const float ViewingTimeout = 2.0f;
+}
+
+FGameplayDebuggerCategory_StateMachine::FGameplayDebuggerCategory_StateMachine()
+{
+	SetDataPackReplication<FRepData>(&DataPack);
+}
+
+FGameplayDebuggerCategory_StateMachine::~FGameplayDebuggerCategory_StateMachine()
+{
+	StopViewing();
+}
+
+void FGameplayDebuggerCategory_StateMachine::StartViewing()
+{
+	LastCollectTime = FPlatformTime::Seconds();
+	if (bViewing)
+		return;
+
+	// Collection runs on the server side replicator too, which is where the transitions happen.
+	FStateMachineDebugger::Get().AddViewer();
+	ViewingTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FGameplayDebuggerCategory_StateMachine::CheckViewing), StateMachineGameplayDebugger::ViewingTimeout);
+	bViewing = true;
+}
+
+void FGameplayDebuggerCategory_StateMachine::StopViewing()
+{
+	if (!bViewing)
+		return;
+
+	FTicker::GetCoreTicker().RemoveTicker(ViewingTickerHandle);
+	ViewingTickerHandle.Reset();
+	FStateMachineDebugger::Get().RemoveViewer();
+	bViewing = false;
+}
+
+bool FGameplayDebuggerCategory_StateMachine::CheckViewing(float DeltaTime)
+{
+	const float Timeout = FMath::Max(StateMachineGameplayDebugger::ViewingTimeout, CollectDataInterval * 2.0f);
+	if (FPlatformTime::Seconds() - LastCollectTime < Timeout)
+		return true;
+
+	// Let the ticker drop the delegate itself by returning false, only the viewer needs releasing here.
+	ViewingTickerHandle.Reset();
+	FStateMachineDebugger::Get().RemoveViewer();
+	bViewing = false;
+	return false;
+}
+
+void FGameplayDebuggerCategory_StateMachine::FRepData::Serialize(FArchive& Ar)
+{
+	Ar << Lines;
+}
+
+void FGameplayDebuggerCategory_StateMachine::CollectData(APlayerController* OwnerPC, AActor* DebugActor)
+{
+	StartViewing();
+
+	DataPack.Lines.Reset();
+
+	TArray<UStateMachine*> StateMachines;
+	if (UStateMachine* StateMachine = DebugActor ? UStateMachineExStatics::GuessStateMachine(DebugActor) : nullptr)
+	{
+		StateMachines.Add(StateMachine);
+	}
+	else if (OwnerPC && OwnerPC->GetPawn())
+	{
+		FStateMachineDebugger::GatherStateMachines(OwnerPC->GetWorld(), OwnerPC->GetPawn()->GetActorLocation(),
+			StateMachineGameplayDebugger::NearbyRadius, StateMachineGameplayDebugger::MaxNearbyStateMachines, StateMachines);
+	}
+
+	for (const UStateMachine* StateMachine : StateMachines)
+	{
+		FStateMachineDebugger::Get().Describe(StateMachine, DataPack.Lines);
+	}
+}
+
+void FGameplayDebuggerCategory_StateMachine::DrawData(APlayerController* OwnerPC, FGameplayDebuggerCanvasContext& CanvasContext)
+{
+	if (DataPack.Lines.Num() == 0)
+	{
+		CanvasContext.Print(TEXT("{grey}No state machines"));
+		return;
+	}
+
+	for (const FString& Line : DataPack.Lines)
+	{
+		CanvasContext.Print(Line.StartsWith(TEXT(" ")) ? FString::Printf(TEXT("{grey}%s"), *Line) : FString::Printf(TEXT("{yellow}%s"), *Line));
+	}
+}
+
+TSharedRef<FGameplayDebuggerCategory> FGameplayDebuggerCategory_StateMachine::MakeInstance()
+{
+	return MakeShareable(new FGameplayDebuggerCategory_StateMachine());
+}
+
+#endif // WITH_GAMEPLAY_DEBUGGER
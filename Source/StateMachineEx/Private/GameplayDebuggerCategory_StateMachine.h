@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_GAMEPLAY_DEBUGGER
+
+#include "GameplayDebuggerCategory.h"
+
+/** Shows the state machines of the selected actor, or the ones nearest to the viewer when nothing is selected. */
+class FGameplayDebuggerCategory_StateMachine : public FGameplayDebuggerCategory
+{
+public:
+	FGameplayDebuggerCategory_StateMachine();
+	virtual ~FGameplayDebuggerCategory_StateMachine();
+
+	virtual void CollectData(APlayerController* OwnerPC, AActor* DebugActor) override;
+	virtual void DrawData(APlayerController* OwnerPC, FGameplayDebuggerCanvasContext& CanvasContext) override;
+
+	static TSharedRef<FGameplayDebuggerCategory> MakeInstance();
+
+protected:
+	struct FRepData
+	{
+		TArray<FString> Lines;
+
+		void Serialize(FArchive& Ar);
+	};
+
+	FRepData DataPack;
+
+private:
+	/**
+	 * A category instance exists for every player's replicator whether or not the debugger is open, so recording only
+	 * starts once data is actually collected and stops again when collection has not run for a while.
+	 */
+	void StartViewing();
+	void StopViewing();
+	bool CheckViewing(float DeltaTime);
+
+	FDelegateHandle ViewingTickerHandle;
+	double LastCollectTime = 0.0;
+	bool bViewing = false;
+};
+
+#endif // WITH_GAMEPLAY_DEBUGGER
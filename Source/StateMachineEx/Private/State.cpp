@@ -1,5 +1,6 @@
 #include "State.h"
 #include "StateMachine.h"
+#include "StateClassRegistry.h"
 
 #include "Kismet/GameplayStatics.h"
 
@@ -8,6 +9,28 @@ UState::UState(const FObjectInitializer& ObjectInitializer)
 {
 }
 
+void UState::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// The class default object gets the id too, so class based lookups can read it without the registry.
+	if (!HasAnyFlags(RF_ArchetypeObject) || HasAnyFlags(RF_ClassDefaultObject))
+	{
+		StateId = FStateClassRegistry::Get().GetId(GetClass());
+	}
+}
+
+#if WITH_EDITOR
+FOnStateClassCompiled UState::OnStateClassCompiled;
+
+void UState::PostCDOCompiled()
+{
+	Super::PostCDOCompiled();
+
+	OnStateClassCompiled.ExecuteIfBound(this);
+}
+#endif // WITH_EDITOR
+
 UWorld* UState::GetWorld() const
 {
 	return (!HasAnyFlags(RF_ClassDefaultObject) && GetOuter()) ? GetOuter()->GetWorld() : nullptr;
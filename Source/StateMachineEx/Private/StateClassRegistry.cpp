@@ -0,0 +1,166 @@
+#include "StateClassRegistry.h"
+#include "StateMachineExModule.h"
+#include "State.h"
+
+#include "StateClassIdTable.h"
+
+#include "Misc/PackageName.h"
+#include "Misc/ScopeRWLock.h"
+
+FStateClassRegistry& FStateClassRegistry::Get()
+{
+	static FStateClassRegistry Registry;
+	return Registry;
+}
+
+void FStateClassRegistry::Initialize()
+{
+	check(IsInGameThread());
+
+	if (bInitialized)
+		return;
+
+	FWriteScopeLock WriteLock(Lock);
+
+	if (Entries.Num() == 0)
+	{
+		Entries.AddDefaulted();
+	}
+
+	// Keep every slot, even for classes this process cannot load, so the ids after it stay put.
+	for (const FSoftClassPath& ClassPath : GetDefault<UStateClassIdTable>()->StateClasses)
+	{
+		const FName ClassPathName(*ClassPath.ToString());
+		ensureMsgf(!IdsByPath.Contains(ClassPathName), TEXT("%s is in the state class id table twice, only the first entry is used."), *ClassPath.ToString());
+		AddEntry(ClassPathName, nullptr);
+	}
+
+	bInitialized = true;
+
+	UE_LOG(LogStateMachineEx, Log, TEXT("Loaded %d state class ids."), Entries.Num() - 1);
+}
+
+bool FStateClassRegistry::IsTransientClass(const UClass* Class)
+{
+	if (Class->HasAnyClassFlags(CLASS_NewerVersionExists))
+		return true;
+
+	const FString ClassName = Class->GetName();
+	return ClassName.StartsWith(TEXT("SKEL_")) || ClassName.StartsWith(TEXT("REINST_")) || ClassName.StartsWith(TEXT("TRASHCLASS_"))
+		|| ClassName.StartsWith(TEXT("HOTRELOADED_"));
+}
+
+FStateClassId FStateClassRegistry::GetId(const UClass* StateClass)
+{
+	if (!StateClass)
+		return InvalidId;
+
+	if (!bInitialized)
+	{
+		// The table's config object cannot be created from a worker.
+		if (!IsInGameThread())
+			return InvalidId;
+
+		Initialize();
+	}
+
+	{
+		// Validate the cached entry, a collected class may have left its address to a new one.
+		FReadScopeLock ReadLock(Lock);
+		const FStateClassId* CachedId = IdsByClass.Find(StateClass);
+		if (CachedId && Entries[*CachedId].Class.Get() == StateClass)
+			return *CachedId;
+	}
+
+	if (IsTransientClass(StateClass))
+		return InvalidId;
+
+	const FName ClassPath(*StateClass->GetPathName());
+
+	FWriteScopeLock WriteLock(Lock);
+
+	// Either a table entry seen for the first time, or a class reinstanced by a recompile.
+	if (const FStateClassId* Id = IdsByPath.Find(ClassPath))
+	{
+		FEntry& Entry = Entries[*Id];
+		if (!Entry.Class.IsValid() || Entry.Class->HasAnyClassFlags(CLASS_NewerVersionExists) || Entry.Class.Get() == StateClass)
+		{
+			Entry.Class = const_cast<UClass*>(StateClass);
+			IdsByClass.Add(StateClass, *Id);
+
+			return *Id;
+		}
+	}
+
+	UE_LOG(LogStateMachineEx, Warning, TEXT("State class %s is not in the state class id table, its id is only valid in this process. Run the StateClassIdTable commandlet."),
+		*ClassPath.ToString());
+
+	return AddEntry(ClassPath, StateClass);
+}
+
+UClass* FStateClassRegistry::GetClass(FStateClassId Id) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Entries.IsValidIndex(Id) ? Entries[Id].Class.Get() : nullptr;
+}
+
+FName FStateClassRegistry::GetClassName(FStateClassId Id) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Entries.IsValidIndex(Id) ? Entries[Id].ClassName : NAME_None;
+}
+
+FName FStateClassRegistry::GetClassPath(FStateClassId Id) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Entries.IsValidIndex(Id) ? Entries[Id].ClassPath : NAME_None;
+}
+
+FStateClassId FStateClassRegistry::AddEntry(FName ClassPath, const UClass* StateClass)
+{
+	if (Entries.Num() == 0)
+	{
+		Entries.AddDefaulted();
+	}
+
+	if (!ensureMsgf(Entries.Num() <= MAX_uint16, TEXT("Out of state class ids, %s will not be registered."), *ClassPath.ToString()))
+		return InvalidId;
+
+	const FStateClassId Id = static_cast<FStateClassId>(Entries.Num());
+
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.ClassPath = ClassPath;
+	Entry.ClassName = FName(*FPackageName::ObjectPathToObjectName(ClassPath.ToString()));
+	Entry.Class = const_cast<UClass*>(StateClass);
+
+	IdsByPath.FindOrAdd(ClassPath, Id);
+	if (StateClass)
+	{
+		IdsByClass.Add(StateClass, Id);
+	}
+
+	return Id;
+}
+
+FStateIdSet::FStateIdSet(std::initializer_list<const UClass*> StateClasses)
+{
+	for (const UClass* StateClass : StateClasses)
+	{
+		Add(StateClass);
+	}
+}
+
+void FStateIdSet::Add(FStateClassId Id)
+{
+	if (Id >= Bits.Num())
+	{
+		Bits.Add(false, Id + 1 - Bits.Num());
+	}
+
+	Bits[Id] = true;
+}
+
+void FStateIdSet::Add(const UClass* StateClass)
+{
+	Add(FStateClassRegistry::Get().GetId(StateClass));
+}
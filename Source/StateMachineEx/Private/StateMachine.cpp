@@ -1,6 +1,17 @@
 #include "StateMachine.h"
 #include "StateMachineExModule.h"
 #include "State.h"
+#include "StateClassRegistry.h"
+#include "StateMachineSubsystem.h"
+#include "StateMachineBulkStorage.h"
+
+#include "Serialization/ArchiveLoadCompressedProxy.h"
+#include "Serialization/ArchiveSaveCompressedProxy.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+
+FOnStateMachineStateEntered UStateMachine::OnStateEntered;
 
 UStateMachine::UStateMachine(const FObjectInitializer &Initializer)
 	: Super(Initializer)
@@ -10,6 +21,16 @@ UStateMachine::UStateMachine(const FObjectInitializer &Initializer)
 {
 }
 
+void UStateMachine::BeginDestroy()
+{
+	if (BulkStorage)
+	{
+		BulkStorage->Remove(this);
+	}
+
+	Super::BeginDestroy();
+}
+
 UWorld* UStateMachine::GetWorld() const
 {
 	return (!HasAnyFlags(RF_ClassDefaultObject) && GetOuter()) ? GetOuter()->GetWorld() : nullptr;
@@ -20,8 +41,124 @@ bool UStateMachine::IsActive() const
 	return IsValid(CurrentState) || IsValid(NextState);
 }
 
+float UStateMachine::GetTimeInState() const
+{
+	return BulkStorage ? BulkStorage->TimeInState[BulkIndex] : TimeInState;
+}
+
+float& UStateMachine::TimeInStateRef()
+{
+	return BulkStorage ? BulkStorage->TimeInState[BulkIndex] : TimeInState;
+}
+
+void UStateMachine::SetPaused(bool bInPaused)
+{
+	bPaused = bInPaused;
+
+	if (BulkStorage)
+	{
+		BulkStorage->Paused[BulkIndex] = bInPaused;
+	}
+}
+
+void UStateMachine::SetTickOrder(int32 InTickOrder)
+{
+	if (TickOrder == InTickOrder)
+		return;
+
+	TickOrder = InTickOrder;
+
+	// Bulk machines tick in registration order, only the ordered list needs sorting.
+	if (RegistryIndex != INDEX_NONE && !bDormantInBulkStorage)
+	{
+		if (UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(this))
+		{
+			Subsystem->bNeedsSort = true;
+		}
+	}
+}
+
+void UStateMachine::SetFixedStep(bool bInFixedStep)
+{
+	bFixedStep = bInFixedStep;
+	StepAccumulator = 0.0f;
+
+	if (BulkStorage)
+	{
+		BulkStorage->NeedsFullTick[BulkIndex] = FStateMachineBulkStorage::RequiresFullTick(this);
+	}
+}
+
+#if WITH_EDITOR
+void UStateMachine::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Edits in a running game go straight to the property, so bring the bulk slot up to date.
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UStateMachine, bFixedStep))
+	{
+		SetFixedStep(bFixedStep);
+	}
+	else if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UStateMachine, TickOrder))
+	{
+		// The property already holds the new value, so skip SetTickOrder's early out.
+		if (UStateMachineSubsystem* Subsystem = (RegistryIndex != INDEX_NONE && !bDormantInBulkStorage) ? UStateMachineSubsystem::Get(this) : nullptr)
+		{
+			Subsystem->bNeedsSort = true;
+		}
+	}
+}
+#endif // WITH_EDITOR
+
+void UStateMachine::SyncBulkStorage()
+{
+	if (!BulkStorage)
+		return;
+
+	BulkStorage->CurrentStates[BulkIndex] = CurrentState;
+	BulkStorage->CurrentStateIds[BulkIndex] = IsValid(CurrentState) ? CurrentState->StateId : FStateClassRegistry::InvalidId;
+	BulkStorage->PendingStateIds[BulkIndex] = IsValid(NextState) ? NextState->StateId : FStateClassRegistry::InvalidId;
+	BulkStorage->TickInParallel[BulkIndex] = FStateMachineBulkStorage::CanTickInParallel(CurrentState);
+}
+
+bool UStateMachine::IsInState(TSubclassOf<UState> StateClass) const
+{
+	// The class default object carries the id, so this does not take the registry lock on every call.
+	const UState* DefaultState = StateClass ? StateClass->GetDefaultObject<UState>() : nullptr;
+	return DefaultState && IsInState(DefaultState->StateId);
+}
+
+bool UStateMachine::IsInState(uint16 StateId) const
+{
+	return IsValid(CurrentState) && StateId != FStateClassRegistry::InvalidId && CurrentState->StateId == StateId;
+}
+
+bool UStateMachine::IsInAnyState(const FStateIdSet& StateIds) const
+{
+	return IsValid(CurrentState) && StateIds.Contains(CurrentState->StateId);
+}
+
 UState* UStateMachine::SwitchState(TSubclassOf<UState> NewStateClass)
 {
+	if (!IsInGameThread() || (BulkStorage && BulkStorage->IsTickingInParallel()))
+	{
+		if (!ensureMsgf(BulkStorage, TEXT("State Machine %s switched state off the game thread without bulk storage to defer to, the switch is dropped."), *GetName()))
+			return nullptr;
+
+		BulkStorage->DeferSwitchState(this, NewStateClass, nullptr);
+		return nullptr;
+	}
+
+#if !UE_BUILD_SHIPPING
+	// Transitions can also be requested from outside the current state, so this is only informative.
+	if (IsValid(CurrentState) && CurrentState->Successors && CurrentState->GetClass() != NewStateClass
+		&& !CurrentState->Successors->States.Contains(TSoftClassPtr<UState>(NewStateClass.Get())))
+	{
+		UE_LOG(LogStateMachineEx, Verbose, TEXT("State Machine %s switches from %s to %s, which is not among its compiled successors."),
+			*GetClass()->GetName(), *CurrentState->GetClass()->GetName(), *GetNameSafe(NewStateClass));
+	}
+#endif // !UE_BUILD_SHIPPING
+
 	UState* NewState = NewObject<UState>(this, NewStateClass);
 	NewState->ConstructState(this);
 
@@ -30,27 +167,214 @@ UState* UStateMachine::SwitchState(TSubclassOf<UState> NewStateClass)
 
 UState* UStateMachine::SwitchState(UState* NewState)
 {
+	if (!IsInGameThread() || (BulkStorage && BulkStorage->IsTickingInParallel()))
+	{
+		if (!ensureMsgf(BulkStorage, TEXT("State Machine %s switched state off the game thread without bulk storage to defer to, the switch is dropped."), *GetName()))
+			return nullptr;
+
+		BulkStorage->DeferSwitchState(this, nullptr, NewState);
+		return nullptr;
+	}
+
+	if (bDormant)
+	{
+		Wake();
+	}
+
 	if (IsValid(CurrentState))
 	{
+		PreviousStateId = CurrentState->StateId;
 		CurrentState->Exit();
 	}
 
 	CurrentState = nullptr;
 	NextState = NewState;
 
-	if (bImmediateStateChange)
+	if (bImmediateStateChange && !bFixedStep)
 	{
 		if (IsValid(NextState))
 		{
-			CurrentState = NextState;
-			NextState = nullptr;
-			CurrentState->Enter();
+			EnterNextState();
 		}
 	}
 
+	SyncBulkStorage();
+
 	return NewState;
 }
 
+void UStateMachine::EnterNextState()
+{
+	CurrentState = NextState;
+	NextState = nullptr;
+
+	TimeInStateRef() = 0.0f;
+
+	OnStateEntered.Broadcast(this, CurrentState);
+	CurrentState->Enter();
+
+	SyncBulkStorage();
+}
+
+uint32 UStateMachine::GetStateHash() const
+{
+	uint32 Hash = GetTypeHash(SimulationStep);
+	Hash = HashCombine(Hash, IsValid(CurrentState) ? GetTypeHash(CurrentState->StateId) : 0);
+	Hash = HashCombine(Hash, GetTypeHash(GetTimeInState()));
+	Hash = HashCombine(Hash, GetTypeHash(IsValid(NextState)));
+	Hash = HashCombine(Hash, IsValid(NextState) ? GetTypeHash(NextState->StateId) : 0);
+	Hash = HashCombine(Hash, GetTypeHash(StateStack.Num()));
+	for (const UState* State : StateStack)
+	{
+		Hash = HashCombine(Hash, IsValid(State) ? GetTypeHash(State->StateId) : 0);
+	}
+	return Hash;
+}
+
+void UStateMachine::Freeze()
+{
+	if (bDormant)
+		return;
+
+	// Current, next and stacked states may share objects, store each one once and refer to it by index.
+	TArray<UState*> States;
+	auto AddState = [&States](UState* State) -> int32
+	{
+		return IsValid(State) ? States.AddUnique(State) : INDEX_NONE;
+	};
+
+	int32 CurrentStateIndex = AddState(CurrentState);
+	int32 NextStateIndex = AddState(NextState);
+	TArray<int32> StateStackIndices;
+	for (UState* State : StateStack)
+	{
+		StateStackIndices.Add(AddState(State));
+	}
+
+	TArray<uint8> RawData;
+	FMemoryWriter Writer(RawData);
+
+	int32 NumStates = States.Num();
+	Writer << NumStates;
+	for (UState* State : States)
+	{
+		FString ClassPath = State->GetClass()->GetPathName();
+
+		// Sized per state so a state whose class is gone can be skipped on Wake.
+		TArray<uint8> StateData;
+		FMemoryWriter StateMemoryWriter(StateData);
+		FObjectAndNameAsStringProxyArchive StateWriter(StateMemoryWriter, false);
+		State->Serialize(StateWriter);
+
+		Writer << ClassPath << StateData;
+	}
+
+	float SavedTimeInState = GetTimeInState();
+	Writer << CurrentStateIndex << NextStateIndex << StateStackIndices << SavedTimeInState << PreviousStateId << StepAccumulator;
+
+	DormantData.Reset();
+	FArchiveSaveCompressedProxy Compressor(DormantData, NAME_Zlib);
+	Compressor << RawData;
+	Compressor.Flush();
+
+	UE_LOG(LogStateMachineEx, Verbose, TEXT("State Machine %s went dormant, %d states in %d bytes."), *GetName(), NumStates, DormantData.Num());
+
+	if (BulkStorage)
+	{
+		// The subsystem remembers the machine so it can be woken, unregistered or shut down while out of the storage.
+		// Without one nothing would, so the machine keeps its slot and skips its ticks while dormant.
+		UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(this);
+		if (ensureMsgf(Subsystem, TEXT("State Machine %s has bulk storage but no subsystem, it stays in the storage while dormant."), *GetName()))
+		{
+			BulkStorage->Remove(this);
+			Subsystem->AddDormantBulkStateMachine(this);
+		}
+	}
+
+	// Release the states without Exit, they continue where they left off on Wake.
+	CurrentState = nullptr;
+	NextState = nullptr;
+	StateStack.Empty();
+
+	bDormant = true;
+	SyncBulkStorage();
+}
+
+void UStateMachine::Wake()
+{
+	if (!bDormant)
+		return;
+
+	bDormant = false;
+
+	TArray<uint8> RawData;
+	FArchiveLoadCompressedProxy Decompressor(DormantData, NAME_Zlib);
+	Decompressor << RawData;
+
+	FMemoryReader Reader(RawData);
+
+	int32 NumStates = 0;
+	Reader << NumStates;
+
+	TArray<UState*> States;
+	for (int32 Index = 0; Index < NumStates; ++Index)
+	{
+		FString ClassPath;
+		TArray<uint8> StateData;
+		Reader << ClassPath << StateData;
+
+		// Keep the slot even if the class is gone, so the indices below stay valid.
+		UClass* StateClass = LoadClass<UState>(nullptr, *ClassPath);
+		if (!StateClass)
+		{
+			UE_LOG(LogStateMachineEx, Warning, TEXT("State Machine %s could not restore a state of class %s."), *GetName(), *ClassPath);
+			States.Add(nullptr);
+			continue;
+		}
+
+		UState* State = NewObject<UState>(this, StateClass);
+
+		FMemoryReader StateMemoryReader(StateData);
+		// Do not try to load what cannot be found, those are transient objects that were collected meanwhile.
+		FObjectAndNameAsStringProxyArchive StateReader(StateMemoryReader, false);
+		State->Serialize(StateReader);
+		State->ConstructState(this);
+
+		States.Add(State);
+	}
+
+	int32 CurrentStateIndex = INDEX_NONE;
+	int32 NextStateIndex = INDEX_NONE;
+	TArray<int32> StateStackIndices;
+	float SavedTimeInState = 0.0f;
+	Reader << CurrentStateIndex << NextStateIndex << StateStackIndices << SavedTimeInState << PreviousStateId << StepAccumulator;
+
+	CurrentState = States.IsValidIndex(CurrentStateIndex) ? States[CurrentStateIndex] : nullptr;
+	NextState = States.IsValidIndex(NextStateIndex) ? States[NextStateIndex] : nullptr;
+	StateStack.Reset(StateStackIndices.Num());
+	for (int32 StateIndex : StateStackIndices)
+	{
+		if (States.IsValidIndex(StateIndex) && States[StateIndex])
+		{
+			StateStack.Add(States[StateIndex]);
+		}
+	}
+
+	DormantData.Empty();
+
+	if (bDormantInBulkStorage)
+	{
+		if (UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(this))
+		{
+			Subsystem->RemoveDormantBulkStateMachine(this);
+			Subsystem->RegisterStateMachine(this);
+		}
+	}
+
+	TimeInStateRef() = SavedTimeInState;
+	SyncBulkStorage();
+}
+
 void UStateMachine::Restart()
 {
 	Shutdown();
@@ -62,6 +386,35 @@ void UStateMachine::Reset_Implementation()
 }
 
 void UStateMachine::Tick_Implementation(float DeltaSeconds)
+{
+	if (bPaused || bDormant)
+		return;
+
+	if (!bFixedStep)
+	{
+		StepState(DeltaSeconds);
+		return;
+	}
+
+	StepAccumulator += DeltaSeconds;
+
+	int32 NumSteps = 0;
+	while (StepAccumulator >= FixedStepSeconds && NumSteps < MaxStepsPerTick)
+	{
+		StepAccumulator -= FixedStepSeconds;
+		StepState(FixedStepSeconds);
+		++NumSteps;
+	}
+
+	if (StepAccumulator >= FixedStepSeconds)
+	{
+		// Fell too far behind. Drop the backlog instead of spiralling into ever longer catch-up ticks.
+		UE_LOG(LogStateMachineEx, Verbose, TEXT("State Machine %s dropped %.3fs of simulation time."), *GetClass()->GetName(), StepAccumulator);
+		StepAccumulator = FMath::Fmod(StepAccumulator, FixedStepSeconds);
+	}
+}
+
+void UStateMachine::StepState(float DeltaSeconds)
 {
 	while (!IsValid(CurrentState))
 	{
@@ -71,34 +424,91 @@ void UStateMachine::Tick_Implementation(float DeltaSeconds)
 			return;
 		}
 
-		UE_LOG(LogStateMachineEx, Log, TEXT("State Machine %s switched to state %s."), *GetClass()->GetName(), *NextState->GetClass()->GetName());
+		UE_LOG(LogStateMachineEx, Log, TEXT("State Machine %s switched to state %s (%d)."), *GetClass()->GetName(), *NextState->GetClass()->GetName(), NextState->StateId);
 
-		CurrentState = NextState;
-		NextState = nullptr;
-		CurrentState->Enter();
+		EnterNextState();
 	}
 
 	if (!CurrentState->bPaused)
 	{
-		CurrentState->Tick(DeltaSeconds);
+		// A state that switches during its Tick must not hand that delta to the state it switched to.
+		UState* TickedState = CurrentState;
+		TickedState->Tick(DeltaSeconds);
+		if (CurrentState == TickedState)
+		{
+			TimeInStateRef() += DeltaSeconds;
+		}
 	}
+
+	++SimulationStep;
 }
 
 void UStateMachine::Shutdown_Implementation()
 {
-	if (IsValid(CurrentState))
+	Teardown(true);
+}
+
+void UStateMachine::Teardown(bool bRunShutdownState)
+{
+	// Shutdown states may themselves ask the machine to shut down.
+	if (bTearingDown)
+		return;
+
+	TGuardValue<bool> TearingDownGuard(bTearingDown, true);
+
+	if (bDormantInBulkStorage)
 	{
-		if (IsValid(ShutdownState))
+		if (UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(this))
 		{
-			SwitchState(ShutdownState);
-			Tick(GetWorld() ? GetWorld()->GetDeltaSeconds() : 0.0f);
+			Subsystem->RemoveDormantBulkStateMachine(this);
 		}
-		if (IsValid(CurrentState))
+		bDormantInBulkStorage = false;
+	}
+
+	// The frozen states were never exited, bring them back so they are. Without a shutdown state the blob just goes.
+	if (bDormant && bRunShutdownState)
+	{
+		Wake();
+	}
+
+	if (IsValid(CurrentState))
+	{
+		PreviousStateId = CurrentState->StateId;
+		CurrentState->Exit();
+		CurrentState = nullptr;
+
+		if (bRunShutdownState && IsValid(ShutdownState))
 		{
-			CurrentState->Exit();
+			UStateMachineSubsystem* Subsystem = UStateMachineSubsystem::Get(this);
+			UState* State = Subsystem ? Subsystem->GetSharedShutdownState(ShutdownState) : NewObject<UState>(this, ShutdownState);
+
+			// Run the shutdown state inline rather than through SwitchState and Tick.
+			State->ConstructState(this);
+			CurrentState = State;
+			NextState = nullptr;
+			TimeInStateRef() = 0.0f;
+
+			OnStateEntered.Broadcast(this, CurrentState);
+			CurrentState->Enter();
+			if (IsValid(CurrentState) && !CurrentState->bPaused)
+			{
+				CurrentState->Tick(bFixedStep ? FixedStepSeconds : (GetWorld() ? GetWorld()->GetDeltaSeconds() : 0.0f));
+			}
+			if (IsValid(CurrentState))
+			{
+				CurrentState->Exit();
+			}
+
+			State->ParentStateMachine = nullptr;
 		}
 	}
 
 	CurrentState = nullptr;
 	NextState = nullptr;
+
+	// A shut down machine has nothing left to wake up.
+	bDormant = false;
+	DormantData.Empty();
+
+	SyncBulkStorage();
 }
@@ -0,0 +1,294 @@
+#include "StateMachineBulkStorage.h"
+#include "StateMachine.h"
+#include "State.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+static TAutoConsoleVariable<int32> CVarStateMachineParallelTick(
+	TEXT("StateMachineEx.ParallelTick"),
+	1,
+	TEXT("Tick native states that allow it on worker threads when their machine uses bulk storage. 0 ticks everything on the game thread."));
+
+/** Slots per worker task, small batches cost more in scheduling than the Tick itself. */
+static const int32 StateMachineParallelTickBatchSize = 64;
+
+int32 FStateMachineBulkStorage::Add(UStateMachine* StateMachine)
+{
+	check(StateMachine && !StateMachine->BulkStorage);
+
+	const int32 Index = Machines.Add(StateMachine);
+	CurrentStates.Add(StateMachine->CurrentState);
+	CurrentStateIds.Add(IsValid(StateMachine->CurrentState) ? StateMachine->CurrentState->StateId : FStateClassRegistry::InvalidId);
+	PendingStateIds.Add(IsValid(StateMachine->NextState) ? StateMachine->NextState->StateId : FStateClassRegistry::InvalidId);
+	TimeInState.Add(StateMachine->TimeInState);
+	Paused.Add(StateMachine->bPaused);
+	NeedsFullTick.Add(RequiresFullTick(StateMachine));
+	TickInParallel.Add(CanTickInParallel(StateMachine->CurrentState));
+	SwitchRequested.Add(false);
+
+	StateMachine->BulkStorage = this;
+	StateMachine->BulkIndex = Index;
+
+	return Index;
+}
+
+bool FStateMachineBulkStorage::RequiresFullTick(const UStateMachine* StateMachine)
+{
+	// Machines with a Blueprint Tick or fixed stepping always go through UStateMachine::Tick.
+	static const FName NAME_Tick = GET_FUNCTION_NAME_CHECKED(UStateMachine, Tick);
+	if (StateMachine->bFixedStep || StateMachine->GetClass()->IsFunctionImplementedInScript(NAME_Tick))
+		return true;
+
+	// So do native subclasses, there is no telling whether they override Tick_Implementation.
+	const UClass* NativeClass = StateMachine->GetClass();
+	while (NativeClass && !NativeClass->HasAnyClassFlags(CLASS_Native))
+	{
+		NativeClass = NativeClass->GetSuperClass();
+	}
+	return NativeClass != UStateMachine::StaticClass();
+}
+
+bool FStateMachineBulkStorage::Contains(const UStateMachine* StateMachine) const
+{
+	return StateMachine && StateMachine->BulkStorage == this;
+}
+
+void FStateMachineBulkStorage::Remove(UStateMachine* StateMachine)
+{
+	if (!StateMachine || StateMachine->BulkStorage != this)
+		return;
+
+	const int32 Index = StateMachine->BulkIndex;
+
+	// Hand the runtime data back to the object.
+	StateMachine->TimeInState = TimeInState[Index];
+	StateMachine->BulkStorage = nullptr;
+	StateMachine->BulkIndex = INDEX_NONE;
+
+	Machines[Index] = nullptr;
+	CurrentStates[Index] = nullptr;
+	CurrentStateIds[Index] = FStateClassRegistry::InvalidId;
+	PendingStateIds[Index] = FStateClassRegistry::InvalidId;
+
+	bNeedsCompact = true;
+}
+
+void FStateMachineBulkStorage::Compact()
+{
+	TBitArray<> CompactPaused;
+	TBitArray<> CompactNeedsFullTick;
+	TBitArray<> CompactTickInParallel;
+
+	int32 WriteIndex = 0;
+	for (int32 ReadIndex = 0; ReadIndex < Machines.Num(); ++ReadIndex)
+	{
+		UStateMachine* StateMachine = Machines[ReadIndex];
+		if (!StateMachine)
+			continue;
+
+		Machines[WriteIndex] = StateMachine;
+		CurrentStates[WriteIndex] = CurrentStates[ReadIndex];
+		CurrentStateIds[WriteIndex] = CurrentStateIds[ReadIndex];
+		PendingStateIds[WriteIndex] = PendingStateIds[ReadIndex];
+		TimeInState[WriteIndex] = TimeInState[ReadIndex];
+		SwitchRequested[WriteIndex] = SwitchRequested[ReadIndex];
+		CompactPaused.Add(Paused[ReadIndex]);
+		CompactNeedsFullTick.Add(NeedsFullTick[ReadIndex]);
+		CompactTickInParallel.Add(TickInParallel[ReadIndex]);
+
+		StateMachine->BulkIndex = WriteIndex;
+		++WriteIndex;
+	}
+
+	const int32 NumRemoved = Machines.Num() - WriteIndex;
+	Machines.RemoveAt(WriteIndex, NumRemoved, false);
+	CurrentStates.RemoveAt(WriteIndex, NumRemoved, false);
+	CurrentStateIds.RemoveAt(WriteIndex, NumRemoved, false);
+	PendingStateIds.RemoveAt(WriteIndex, NumRemoved, false);
+	TimeInState.RemoveAt(WriteIndex, NumRemoved, false);
+	SwitchRequested.RemoveAt(WriteIndex, NumRemoved, false);
+	Paused = MoveTemp(CompactPaused);
+	NeedsFullTick = MoveTemp(CompactNeedsFullTick);
+	TickInParallel = MoveTemp(CompactTickInParallel);
+
+	bNeedsCompact = false;
+}
+
+void FStateMachineBulkStorage::Reset()
+{
+	for (int32 Index = 0; Index < Machines.Num(); ++Index)
+	{
+		if (UStateMachine* StateMachine = Machines[Index])
+		{
+			StateMachine->TimeInState = TimeInState[Index];
+			StateMachine->BulkStorage = nullptr;
+			StateMachine->BulkIndex = INDEX_NONE;
+		}
+	}
+
+	Machines.Reset();
+	CurrentStates.Reset();
+	CurrentStateIds.Reset();
+	PendingStateIds.Reset();
+	TimeInState.Reset();
+	SwitchRequested.Reset();
+	Paused.Empty();
+	NeedsFullTick.Empty();
+	TickInParallel.Empty();
+	ParallelIndices.Reset();
+	DeferredSwitches.Empty();
+	SortedSwitches.Reset();
+
+	bNeedsCompact = false;
+}
+
+void FStateMachineBulkStorage::Tick(float DeltaSeconds)
+{
+	if (bNeedsCompact)
+	{
+		Compact();
+	}
+
+	const bool bAllowParallel = CVarStateMachineParallelTick.GetValueOnGameThread() != 0 && FApp::ShouldUseThreadingForPerformance();
+	ParallelIndices.Reset();
+
+	// Machines added while ticking wait for the next frame.
+	const int32 Count = Machines.Num();
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		if (Paused[Index])
+			continue;
+
+		if (bAllowParallel && TickInParallel[Index] && !NeedsFullTick[Index])
+		{
+			ParallelIndices.Add(Index);
+			continue;
+		}
+
+		UState* State = CurrentStates[Index];
+		if (!State || NeedsFullTick[Index])
+		{
+			UStateMachine* StateMachine = Machines[Index];
+			if (!StateMachine)
+			{
+				// Collected without being unregistered.
+				bNeedsCompact = true;
+			}
+			else if (NeedsFullTick[Index] || IsValid(StateMachine->NextState))
+			{
+				StateMachine->Tick(DeltaSeconds);
+			}
+			continue;
+		}
+
+		if (!State->bPaused)
+		{
+			State->Tick(DeltaSeconds);
+			if (CurrentStates[Index] == State)
+			{
+				TimeInState[Index] += DeltaSeconds;
+			}
+		}
+	}
+
+	if (ParallelIndices.Num() > 0)
+	{
+		TGuardValue<bool> TickingInParallelGuard(bTickingInParallel, true);
+
+		const int32 NumBatches = FMath::DivideAndRoundUp(ParallelIndices.Num(), StateMachineParallelTickBatchSize);
+		ParallelFor(NumBatches, [this, DeltaSeconds](int32 BatchIndex)
+		{
+			const int32 Start = BatchIndex * StateMachineParallelTickBatchSize;
+			const int32 End = FMath::Min(Start + StateMachineParallelTickBatchSize, ParallelIndices.Num());
+			for (int32 Position = Start; Position < End; ++Position)
+			{
+				// The serial pass may have switched this machine's state since it was gathered.
+				const int32 Index = ParallelIndices[Position];
+				UState* State = CurrentStates[Index];
+				if (State && TickInParallel[Index] && !State->bPaused)
+				{
+					// A switch requested by this tick is applied later, the time belongs to neither state until then.
+					State->TickNative(DeltaSeconds);
+					if (!SwitchRequested[Index])
+					{
+						TimeInState[Index] += DeltaSeconds;
+					}
+				}
+			}
+		});
+	}
+
+	ApplyDeferredSwitches();
+}
+
+void FStateMachineBulkStorage::DeferSwitchState(UStateMachine* StateMachine, UClass* StateClass, UState* State)
+{
+	SwitchRequested[StateMachine->BulkIndex] = true;
+	DeferredSwitches.Enqueue(FDeferredSwitch{ StateMachine->BulkIndex, StateMachine, StateClass, State });
+}
+
+void FStateMachineBulkStorage::ApplyDeferredSwitches()
+{
+	FDeferredSwitch Switch;
+	while (DeferredSwitches.Dequeue(Switch))
+	{
+		SortedSwitches.Add(Switch);
+	}
+
+	// Workers enqueue in whatever order they finish. A slot is only ticked by one worker, so its own requests are
+	// already in order and the stable sort keeps them that way.
+	SortedSwitches.StableSort([](const FDeferredSwitch& A, const FDeferredSwitch& B) { return A.Index < B.Index; });
+
+	// Slots only move in Compact at the start of Tick, so the queued indices are still valid.
+	for (const FDeferredSwitch& SortedSwitch : SortedSwitches)
+	{
+		SwitchRequested[SortedSwitch.Index] = false;
+	}
+
+	for (const FDeferredSwitch& SortedSwitch : SortedSwitches)
+	{
+		// An earlier switch's Enter or Exit may have destroyed the machine.
+		if (!IsValid(SortedSwitch.StateMachine))
+			continue;
+
+		if (SortedSwitch.State)
+		{
+			SortedSwitch.StateMachine->SwitchState(SortedSwitch.State);
+		}
+		else
+		{
+			SortedSwitch.StateMachine->SwitchState(TSubclassOf<UState>(SortedSwitch.StateClass));
+		}
+	}
+
+	SortedSwitches.Reset();
+}
+
+bool FStateMachineBulkStorage::CanTickInParallel(const UState* State)
+{
+	if (!IsValid(State) || !State->CanTickInParallel())
+		return false;
+
+	// A Blueprint Tick has to go through ProcessEvent on the game thread.
+	static const FName NAME_Tick = GET_FUNCTION_NAME_CHECKED(UState, Tick);
+	return !State->GetClass()->IsFunctionImplementedInScript(NAME_Tick);
+}
+
+int32 FStateMachineBulkStorage::CountInState(FStateClassId StateId) const
+{
+	int32 Count = 0;
+	for (const FStateClassId CurrentStateId : CurrentStateIds)
+	{
+		Count += (CurrentStateId == StateId) ? 1 : 0;
+	}
+	return Count;
+}
+
+void FStateMachineBulkStorage::AddReferencedObjects(FReferenceCollector& Collector, const UObject* ReferencingObject)
+{
+	// Collector clears references to objects pending kill, which the tick then skips.
+	Collector.AddReferencedObjects(Machines, ReferencingObject);
+	Collector.AddReferencedObjects(CurrentStates, ReferencingObject);
+}
@@ -0,0 +1,202 @@
+#include "StateMachineDebugger.h"
+#include "StateMachineExModule.h"
+#include "StateMachine.h"
+#include "StateMachineSubsystem.h"
+#include "State.h"
+
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+void FStateMachineDebugRecord::Add(FStateClassId FromStateId, FStateClassId ToStateId, float WorldTime)
+{
+	FTransition& Transition = Transitions[NumTransitions % MaxTransitions];
+	Transition.FromStateId = FromStateId;
+	Transition.ToStateId = ToStateId;
+	Transition.WorldTime = WorldTime;
+
+	++NumTransitions;
+}
+
+const FStateMachineDebugRecord::FTransition& FStateMachineDebugRecord::GetRecent(int32 Index) const
+{
+	check(Index >= 0 && Index < NumRecent());
+	return Transitions[(NumTransitions - 1 - Index) % MaxTransitions];
+}
+
+FStateMachineDebugger& FStateMachineDebugger::Get()
+{
+	static FStateMachineDebugger Debugger;
+	return Debugger;
+}
+
+void FStateMachineDebugger::AddViewer()
+{
+	if (NumViewers++ == 0)
+	{
+		StateEnteredHandle = UStateMachine::OnStateEntered.AddRaw(this, &FStateMachineDebugger::OnStateEntered);
+	}
+}
+
+void FStateMachineDebugger::RemoveViewer()
+{
+	if (NumViewers > 0 && --NumViewers == 0)
+	{
+		UStateMachine::OnStateEntered.Remove(StateEnteredHandle);
+		Records.Empty();
+		NumRecordsBeforePrune = MinRecordsBeforePrune;
+	}
+}
+
+const FStateMachineDebugRecord* FStateMachineDebugger::FindRecord(const UStateMachine* StateMachine) const
+{
+	return Records.Find(StateMachine);
+}
+
+void FStateMachineDebugger::OnStateEntered(UStateMachine* StateMachine, UState* State)
+{
+	const UWorld* World = StateMachine->GetWorld();
+	Records.FindOrAdd(StateMachine).Add(StateMachine->GetPreviousStateId(), State->StateId, World ? World->GetTimeSeconds() : 0.0f);
+
+	if (Records.Num() >= NumRecordsBeforePrune)
+	{
+		PruneRecords();
+	}
+}
+
+void FStateMachineDebugger::PruneRecords()
+{
+	for (auto It = Records.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	Records.Compact();
+
+	// Doubling keeps the pruning cost constant per recorded transition.
+	NumRecordsBeforePrune = FMath::Max<int32>(MinRecordsBeforePrune, Records.Num() * 2);
+}
+
+void FStateMachineDebugger::Describe(const UStateMachine* StateMachine, TArray<FString>& OutLines) const
+{
+	const FStateClassRegistry& Registry = FStateClassRegistry::Get();
+	auto GetStateName = [&Registry](FStateClassId Id) { return Id == FStateClassRegistry::InvalidId ? FString(TEXT("<none>")) : Registry.GetClassName(Id).ToString(); };
+
+	const AActor* Owner = StateMachine->GetTypedOuter<AActor>();
+	const UState* CurrentState = StateMachine->CurrentState;
+	const UState* NextState = StateMachine->NextState;
+
+	FString Line = FString::Printf(TEXT("%s (%s): %s for %.2fs, next %s"),
+		*StateMachine->GetName(),
+		*GetNameSafe(Owner),
+		IsValid(CurrentState) ? *GetStateName(CurrentState->StateId) : TEXT("<none>"),
+		StateMachine->GetTimeInState(),
+		IsValid(NextState) ? *GetStateName(NextState->StateId) : TEXT("<none>"));
+
+	if (StateMachine->IsPaused() || (IsValid(CurrentState) && CurrentState->bPaused))
+	{
+		Line += TEXT(", paused");
+	}
+	if (StateMachine->bDormant)
+	{
+		Line += TEXT(", dormant");
+	}
+	OutLines.Add(MoveTemp(Line));
+
+	if (const FStateMachineDebugRecord* Record = FindRecord(StateMachine))
+	{
+		for (int32 Index = 0; Index < Record->NumRecent(); ++Index)
+		{
+			const FStateMachineDebugRecord::FTransition& Transition = Record->GetRecent(Index);
+			OutLines.Add(FString::Printf(TEXT("    %.2fs %s -> %s"), Transition.WorldTime, *GetStateName(Transition.FromStateId), *GetStateName(Transition.ToStateId)));
+		}
+	}
+}
+
+void FStateMachineDebugger::GatherStateMachines(UWorld* World, const FVector& Origin, float Radius, int32 MaxCount, TArray<UStateMachine*>& OutStateMachines)
+{
+	UStateMachineSubsystem* Subsystem = World ? World->GetSubsystem<UStateMachineSubsystem>() : nullptr;
+	if (!Subsystem)
+		return;
+
+	TArray<UStateMachine*> StateMachines;
+	Subsystem->GetRegisteredStateMachines(StateMachines);
+
+	TArray<TPair<float, UStateMachine*>> Candidates;
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		// Machines without an owner have no location. They cannot be in range, and without a radius they sort last.
+		const AActor* Owner = StateMachine->GetTypedOuter<AActor>();
+		if (!Owner && Radius > 0.0f)
+			continue;
+
+		const float DistanceSquared = Owner ? FVector::DistSquared(Owner->GetActorLocation(), Origin) : MAX_flt;
+		if (Radius <= 0.0f || DistanceSquared <= FMath::Square(Radius))
+		{
+			Candidates.Emplace(DistanceSquared, StateMachine);
+		}
+	}
+
+	Candidates.Sort([](const TPair<float, UStateMachine*>& A, const TPair<float, UStateMachine*>& B) { return A.Key < B.Key; });
+
+	for (int32 Index = 0; Index < Candidates.Num() && (MaxCount <= 0 || Index < MaxCount); ++Index)
+	{
+		OutStateMachines.Add(Candidates[Index].Value);
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommand StateMachineDebugRecordCommand(
+	TEXT("StateMachineEx.Debug.Record"),
+	TEXT("Record state machine transitions for inspection. Usage: StateMachineEx.Debug.Record <0/1>"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		static bool bRecording = false;
+
+		const bool bEnable = Args.Num() > 0 ? Args[0].ToBool() : !bRecording;
+		if (bEnable != bRecording)
+		{
+			bRecording = bEnable;
+			bRecording ? FStateMachineDebugger::Get().AddViewer() : FStateMachineDebugger::Get().RemoveViewer();
+		}
+
+		UE_LOG(LogStateMachineEx, Display, TEXT("State machine transition recording %s."), bRecording ? TEXT("enabled") : TEXT("disabled"));
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs StateMachineDebugDumpCommand(
+	TEXT("StateMachineEx.Debug.Dump"),
+	TEXT("Log the state of machines near the first local player, or all of them. Usage: StateMachineEx.Debug.Dump [Radius] [MaxCount]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+			return;
+
+		const float Radius = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.0f;
+		const int32 MaxCount = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 20;
+
+		// A dedicated server has no local player, so there everything is measured from the origin.
+		FVector Origin = FVector::ZeroVector;
+		const APlayerController* PlayerController = World->GetFirstPlayerController();
+		if (PlayerController && PlayerController->GetPawn())
+		{
+			Origin = PlayerController->GetPawn()->GetActorLocation();
+		}
+
+		TArray<UStateMachine*> StateMachines;
+		FStateMachineDebugger::GatherStateMachines(World, Origin, Radius, MaxCount, StateMachines);
+
+		TArray<FString> Lines;
+		for (const UStateMachine* StateMachine : StateMachines)
+		{
+			FStateMachineDebugger::Get().Describe(StateMachine, Lines);
+		}
+
+		for (const FString& Line : Lines)
+		{
+			UE_LOG(LogStateMachineEx, Display, TEXT("%s"), *Line);
+		}
+	}));
+#endif // !UE_BUILD_SHIPPING
@@ -1,13 +1,40 @@
 #include "StateMachineExModule.h"
+#include "StateClassRegistry.h"
+#include "GameplayDebuggerCategory_StateMachine.h"
+
+#include "Misc/CoreDelegates.h"
+
+#if WITH_GAMEPLAY_DEBUGGER
+#include "GameplayDebugger.h"
+#endif // WITH_GAMEPLAY_DEBUGGER
 
 #define LOCTEXT_NAMESPACE "FStateMachineExModule"
 
 void FStateMachineExModule::StartupModule()
 {
+	// Load the id table on the game thread before any worker can ask for an id.
+	FCoreDelegates::OnPostEngineInit.AddLambda([]()
+	{
+		FStateClassRegistry::Get().Initialize();
+	});
+
+#if WITH_GAMEPLAY_DEBUGGER
+	IGameplayDebugger& GameplayDebuggerModule = IGameplayDebugger::Get();
+	GameplayDebuggerModule.RegisterCategory("StateMachine", IGameplayDebugger::FOnGetCategory::CreateStatic(&FGameplayDebuggerCategory_StateMachine::MakeInstance), EGameplayDebuggerCategoryState::EnabledInGameAndSimulate);
+	GameplayDebuggerModule.NotifyCategoriesChanged();
+#endif // WITH_GAMEPLAY_DEBUGGER
 }
 
 void FStateMachineExModule::ShutdownModule()
 {
+#if WITH_GAMEPLAY_DEBUGGER
+	if (IGameplayDebugger::IsAvailable())
+	{
+		IGameplayDebugger& GameplayDebuggerModule = IGameplayDebugger::Get();
+		GameplayDebuggerModule.UnregisterCategory("StateMachine");
+		GameplayDebuggerModule.NotifyCategoriesChanged();
+	}
+#endif // WITH_GAMEPLAY_DEBUGGER
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,447 @@
+#include "StateMachineSubsystem.h"
+#include "StateMachineExModule.h"
+#include "StateMachine.h"
+#include "State.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("State Machine Teardown"), STAT_StateMachineTeardown, STATGROUP_Game);
+
+UStateMachineSubsystem* UStateMachineSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr;
+	return World ? World->GetSubsystem<UStateMachineSubsystem>() : nullptr;
+}
+
+void UStateMachineSubsystem::RegisterStateMachine(UStateMachine* StateMachine)
+{
+	if (!IsValid(StateMachine))
+		return;
+
+	if (StateMachine->bUseBulkStorage)
+	{
+		if (!BulkStorage.Contains(StateMachine))
+		{
+			BulkStorage.Add(StateMachine);
+		}
+		return;
+	}
+
+	if (StateMachine->RegistryIndex != INDEX_NONE)
+		return;
+
+	StateMachine->RegistryIndex = StateMachines.Add(StateMachine);
+	bNeedsSort = true;
+}
+
+void UStateMachineSubsystem::UnregisterStateMachine(UStateMachine* StateMachine)
+{
+	if (!StateMachine)
+		return;
+
+	BulkStorage.Remove(StateMachine);
+
+	// Dormant bulk machines must not come back into the storage when woken later.
+	if (StateMachine->bDormantInBulkStorage)
+	{
+		RemoveDormantBulkStateMachine(StateMachine);
+		return;
+	}
+
+	// Leave a hole and compact on the next tick, so unregistering is constant time and the remaining
+	// machines keep their relative update order.
+	const int32 Index = StateMachine->RegistryIndex;
+	if (StateMachines.IsValidIndex(Index) && StateMachines[Index] == StateMachine)
+	{
+		StateMachines[Index] = nullptr;
+		StateMachine->RegistryIndex = INDEX_NONE;
+		bNeedsSort = true;
+	}
+}
+
+void UStateMachineSubsystem::TickStateMachines(float DeltaSeconds)
+{
+	if (bNeedsSort)
+	{
+		SortStateMachines();
+	}
+
+	for (int32 Index = 0; Index < StateMachines.Num(); ++Index)
+	{
+		UStateMachine* StateMachine = StateMachines[Index];
+		if (IsValid(StateMachine))
+		{
+			StateMachine->Tick(DeltaSeconds);
+		}
+	}
+
+	BulkStorage.Tick(DeltaSeconds);
+}
+
+void UStateMachineSubsystem::SortStateMachines()
+{
+	StateMachines.RemoveAll([](const UStateMachine* StateMachine) { return !IsValid(StateMachine); });
+
+	// Stable sort keeps registration order between machines sharing a TickOrder.
+	StateMachines.StableSort([](const UStateMachine& A, const UStateMachine& B) { return A.TickOrder < B.TickOrder; });
+
+	for (int32 Index = 0; Index < StateMachines.Num(); ++Index)
+	{
+		StateMachines[Index]->RegistryIndex = Index;
+	}
+
+	bNeedsSort = false;
+}
+
+void UStateMachineSubsystem::SetShutdownOptions(bool bInRunShutdownStates, int32 MachinesPerFrame)
+{
+	bRunShutdownStates = bInRunShutdownStates;
+	ShutdownsPerFrame = MachinesPerFrame;
+
+	if (MachinesPerFrame <= 0)
+	{
+		FlushShutdowns();
+	}
+}
+
+void UStateMachineSubsystem::ShutdownAll(bool bInRunShutdownStates, int32 MachinesPerFrame)
+{
+	if (bNeedsSort)
+	{
+		SortStateMachines();
+	}
+
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		StateMachine->RegistryIndex = INDEX_NONE;
+	}
+	PendingShutdowns.Append(StateMachines);
+	StateMachines.Reset();
+
+	for (UStateMachine* StateMachine : BulkStorage.Machines)
+	{
+		if (StateMachine)
+		{
+			PendingShutdowns.Add(StateMachine);
+		}
+	}
+	BulkStorage.Reset();
+
+	for (const TWeakObjectPtr<UStateMachine>& WeakStateMachine : DormantBulkStateMachines)
+	{
+		if (UStateMachine* StateMachine = WeakStateMachine.Get())
+		{
+			StateMachine->bDormantInBulkStorage = false;
+			StateMachine->RegistryIndex = INDEX_NONE;
+			PendingShutdowns.Add(StateMachine);
+		}
+	}
+	DormantBulkStateMachines.Reset();
+	NumDormantBulkHoles = 0;
+
+	SetShutdownOptions(bInRunShutdownStates, MachinesPerFrame);
+}
+
+void UStateMachineSubsystem::QueueShutdown(UStateMachine* StateMachine, bool bInRunShutdownStates, int32 MachinesPerFrame)
+{
+	if (!IsValid(StateMachine))
+		return;
+
+	UnregisterStateMachine(StateMachine);
+
+	PendingShutdowns.Add(StateMachine);
+	SetShutdownOptions(bInRunShutdownStates, MachinesPerFrame);
+}
+
+void UStateMachineSubsystem::QueueShutdownWithin(UObject* Outer, bool bInRunShutdownStates, int32 MachinesPerFrame)
+{
+	if (!IsValid(Outer))
+		return;
+
+	if (bNeedsSort)
+	{
+		SortStateMachines();
+	}
+
+	// Gather first, keeping tick order, since unregistering changes the lists being walked.
+	const int32 FirstIndex = PendingShutdowns.Num();
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		if (StateMachine->IsIn(Outer))
+		{
+			PendingShutdowns.Add(StateMachine);
+		}
+	}
+	for (UStateMachine* StateMachine : BulkStorage.Machines)
+	{
+		if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+		{
+			PendingShutdowns.Add(StateMachine);
+		}
+	}
+	for (const TWeakObjectPtr<UStateMachine>& WeakStateMachine : DormantBulkStateMachines)
+	{
+		UStateMachine* StateMachine = WeakStateMachine.Get();
+		if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+		{
+			PendingShutdowns.Add(StateMachine);
+		}
+	}
+
+	for (int32 Index = FirstIndex; Index < PendingShutdowns.Num(); ++Index)
+	{
+		UnregisterStateMachine(PendingShutdowns[Index]);
+	}
+
+	SetShutdownOptions(bInRunShutdownStates, MachinesPerFrame);
+}
+
+void UStateMachineSubsystem::FlushShutdowns()
+{
+	ProcessShutdowns(MAX_int32);
+}
+
+void UStateMachineSubsystem::ProcessShutdowns(int32 MaxCount)
+{
+	// A shutdown state may queue more machines, those are picked up by a later batch.
+	if (PendingShutdowns.Num() == 0 || bProcessingShutdowns)
+		return;
+
+	TGuardValue<bool> ProcessingGuard(bProcessingShutdowns, true);
+
+	SCOPE_CYCLE_COUNTER(STAT_StateMachineTeardown);
+	const double StartTime = FPlatformTime::Seconds();
+
+	const int32 EndIndex = NextShutdownIndex + FMath::Min(PendingShutdowns.Num() - NextShutdownIndex, FMath::Max(MaxCount, 1));
+	for (; NextShutdownIndex < EndIndex && NextShutdownIndex < PendingShutdowns.Num(); ++NextShutdownIndex)
+	{
+		UStateMachine* StateMachine = PendingShutdowns[NextShutdownIndex];
+		if (IsValid(StateMachine))
+		{
+			// Through Shutdown so Blueprint and native overrides still run, it ends in Teardown(true) by default.
+			if (bRunShutdownStates)
+			{
+				StateMachine->Shutdown();
+			}
+			else
+			{
+				StateMachine->Teardown(false);
+			}
+			++CurrentTeardownStats.NumStateMachines;
+		}
+	}
+
+	CurrentTeardownStats.Seconds += FPlatformTime::Seconds() - StartTime;
+	++CurrentTeardownStats.NumFrames;
+
+	if (NextShutdownIndex >= PendingShutdowns.Num())
+	{
+		UE_LOG(LogStateMachineEx, Log, TEXT("Tore down %d state machines in %.2f ms over %d frame(s)."),
+			CurrentTeardownStats.NumStateMachines, CurrentTeardownStats.Seconds * 1000.0f, CurrentTeardownStats.NumFrames);
+
+		LastTeardownStats = CurrentTeardownStats;
+		CurrentTeardownStats = FStateMachineTeardownStats();
+
+		PendingShutdowns.Reset();
+		NextShutdownIndex = 0;
+	}
+}
+
+UState* UStateMachineSubsystem::GetSharedShutdownState(TSubclassOf<UState> StateClass)
+{
+	UState*& State = SharedShutdownStates.FindOrAdd(StateClass);
+	if (!IsValid(State))
+	{
+		State = NewObject<UState>(this, StateClass);
+	}
+
+	return State;
+}
+
+void UStateMachineSubsystem::SetDormantWithin(UObject* Outer, bool bDormant)
+{
+	if (!IsValid(Outer))
+		return;
+
+	if (bDormant)
+	{
+		for (UStateMachine* StateMachine : StateMachines)
+		{
+			if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+			{
+				StateMachine->Freeze();
+			}
+		}
+
+		// Freezing removes bulk machines from the storage, so collect them first.
+		TArray<UStateMachine*> BulkStateMachines;
+		for (UStateMachine* StateMachine : BulkStorage.Machines)
+		{
+			if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+			{
+				BulkStateMachines.Add(StateMachine);
+			}
+		}
+
+		for (UStateMachine* StateMachine : BulkStateMachines)
+		{
+			StateMachine->Freeze();
+		}
+	}
+	else
+	{
+		for (UStateMachine* StateMachine : StateMachines)
+		{
+			if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+			{
+				StateMachine->Wake();
+			}
+		}
+
+		// Waking only leaves holes behind, so indexing stays valid while walking the list.
+		for (int32 Index = 0; Index < DormantBulkStateMachines.Num(); ++Index)
+		{
+			UStateMachine* StateMachine = DormantBulkStateMachines[Index].Get();
+			if (IsValid(StateMachine) && StateMachine->IsIn(Outer))
+			{
+				StateMachine->Wake();
+			}
+		}
+
+		CompactDormantBulkStateMachines();
+	}
+}
+
+void UStateMachineSubsystem::GetRegisteredStateMachines(TArray<UStateMachine*>& OutStateMachines) const
+{
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		if (IsValid(StateMachine))
+		{
+			OutStateMachines.Add(StateMachine);
+		}
+	}
+	for (UStateMachine* StateMachine : BulkStorage.Machines)
+	{
+		if (IsValid(StateMachine))
+		{
+			OutStateMachines.Add(StateMachine);
+		}
+	}
+	for (const TWeakObjectPtr<UStateMachine>& WeakStateMachine : DormantBulkStateMachines)
+	{
+		if (UStateMachine* StateMachine = WeakStateMachine.Get())
+		{
+			OutStateMachines.Add(StateMachine);
+		}
+	}
+}
+
+void UStateMachineSubsystem::AddDormantBulkStateMachine(UStateMachine* StateMachine)
+{
+	check(!StateMachine->bDormantInBulkStorage);
+
+	if (NumDormantBulkHoles > DormantBulkStateMachines.Num() / 2)
+	{
+		CompactDormantBulkStateMachines();
+	}
+
+	StateMachine->RegistryIndex = DormantBulkStateMachines.Add(StateMachine);
+	StateMachine->bDormantInBulkStorage = true;
+}
+
+void UStateMachineSubsystem::RemoveDormantBulkStateMachine(UStateMachine* StateMachine)
+{
+	const int32 Index = StateMachine->RegistryIndex;
+	if (DormantBulkStateMachines.IsValidIndex(Index) && DormantBulkStateMachines[Index].Get() == StateMachine)
+	{
+		DormantBulkStateMachines[Index].Reset();
+		++NumDormantBulkHoles;
+	}
+
+	StateMachine->RegistryIndex = INDEX_NONE;
+	StateMachine->bDormantInBulkStorage = false;
+}
+
+void UStateMachineSubsystem::CompactDormantBulkStateMachines()
+{
+	// Only the dormant list is compacted. Woken machines are appended to the bulk storage, so their tick order there
+	// follows wake order, not their order before the freeze.
+	int32 WriteIndex = 0;
+	for (int32 ReadIndex = 0; ReadIndex < DormantBulkStateMachines.Num(); ++ReadIndex)
+	{
+		UStateMachine* StateMachine = DormantBulkStateMachines[ReadIndex].Get();
+		if (!StateMachine)
+			continue;
+
+		DormantBulkStateMachines[WriteIndex] = StateMachine;
+		StateMachine->RegistryIndex = WriteIndex;
+		++WriteIndex;
+	}
+
+	DormantBulkStateMachines.SetNum(WriteIndex, false);
+	NumDormantBulkHoles = 0;
+}
+
+void UStateMachineSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	UStateMachineSubsystem* This = CastChecked<UStateMachineSubsystem>(InThis);
+	This->BulkStorage.AddReferencedObjects(Collector, This);
+
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+void UStateMachineSubsystem::Deinitialize()
+{
+	FlushShutdowns();
+
+	for (UStateMachine* StateMachine : StateMachines)
+	{
+		if (StateMachine)
+		{
+			StateMachine->RegistryIndex = INDEX_NONE;
+		}
+	}
+	StateMachines.Empty();
+	BulkStorage.Reset();
+	for (const TWeakObjectPtr<UStateMachine>& WeakStateMachine : DormantBulkStateMachines)
+	{
+		if (UStateMachine* StateMachine = WeakStateMachine.Get())
+		{
+			StateMachine->bDormantInBulkStorage = false;
+			StateMachine->RegistryIndex = INDEX_NONE;
+		}
+	}
+	DormantBulkStateMachines.Empty();
+	NumDormantBulkHoles = 0;
+	SharedShutdownStates.Empty();
+
+	Super::Deinitialize();
+}
+
+void UStateMachineSubsystem::Tick(float DeltaSeconds)
+{
+	TickStateMachines(DeltaSeconds);
+	ProcessShutdowns(ShutdownsPerFrame);
+}
+
+bool UStateMachineSubsystem::IsTickable() const
+{
+	return StateMachines.Num() > 0 || BulkStorage.Num() > 0 || PendingShutdowns.Num() > 0;
+}
+
+ETickableTickType UStateMachineSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+UWorld* UStateMachineSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+TStatId UStateMachineSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UStateMachineSubsystem, STATGROUP_Tickables);
+}
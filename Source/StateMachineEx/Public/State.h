@@ -3,6 +3,24 @@
 #include "CoreMinimal.h"
 #include "State.generated.h"
 
+/**
+ * States a state class can switch to, filled in by the Blueprint compiler for tooling and validation. State nodes
+ * reference their class directly, so these are already loaded along with the class.
+ */
+UCLASS()
+class STATEMACHINEEX_API UStateSuccessors : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(VisibleAnywhere, Category = "State Machine")
+	TArray<TSoftClassPtr<class UState>> States;
+};
+
+#if WITH_EDITOR
+DECLARE_DELEGATE_OneParam(FOnStateClassCompiled, class UState* /*DefaultObject*/);
+#endif // WITH_EDITOR
+
 UCLASS(abstract, Blueprintable, BlueprintType)
 class STATEMACHINEEX_API UState : public UObject
 {
@@ -12,14 +30,19 @@ public:
 	virtual class UWorld* GetWorld() const override;
 	   
 public:
-	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine")
-	uint8 StateId;
+	/** Id of this state's class in FStateClassRegistry, also set on the class default object. */
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "State Machine")
+	uint16 StateId;
 
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine")
 	class UStateMachine* ParentStateMachine;
 
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, Category = "State Machine")
 	bool bPaused;
+
+	/** Null for native states, which the compiler cannot analyze. Shared by all instances of the class. */
+	UPROPERTY(VisibleDefaultsOnly, Category = "State Machine", AdvancedDisplay)
+	UStateSuccessors* Successors;
 	   
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "State Machine: State")
@@ -33,12 +56,34 @@ public:
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "State Machine: State")
 	void Restart();
+
+	UFUNCTION(BlueprintPure, Category = "State Machine: State")
+	int32 GetStateId() const { return StateId; }
 	   
 public:
 	UState(const FObjectInitializer& ObjectInitializer);
 
+	virtual void PostInitProperties() override;
+
+#if WITH_EDITOR
+	virtual void PostCDOCompiled() override;
+
+	/** Bound by the developer module to analyze the state graph after a state Blueprint compiles. */
+	static FOnStateClassCompiled OnStateClassCompiled;
+#endif // WITH_EDITOR
+
 	virtual void ConstructState(class UStateMachine *StateMachine)
 	{
 		ParentStateMachine = StateMachine;
 	}
+
+	/**
+	 * Native states whose Tick only touches their own data can return true to be ticked on worker threads by
+	 * FStateMachineBulkStorage. Switching state from there is deferred to the game thread, Enter and Exit always run
+	 * on the game thread. Ignored when a Blueprint subclass implements Tick.
+	 */
+	virtual bool CanTickInParallel() const { return false; }
+
+	/** Runs the native Tick without going through ProcessEvent, which is not safe off the game thread. */
+	void TickNative(float DeltaSeconds) { Tick_Implementation(DeltaSeconds); }
 };
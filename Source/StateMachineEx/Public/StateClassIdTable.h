@@ -0,0 +1,21 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/SoftObjectPath.h"
+#include "StateClassIdTable.generated.h"
+
+/**
+ * Fixed state class ids, shipped in Config/DefaultStateMachineEx.ini so the editor, cooked game and server all use the
+ * same ones. The class at index N has id N + 1.
+ *
+ * Maintained by the StateClassIdTable commandlet, which only ever appends, so an id never changes once assigned.
+ */
+UCLASS(config = StateMachineEx, defaultconfig)
+class STATEMACHINEEX_API UStateClassIdTable : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(config, VisibleAnywhere, Category = "State Machine")
+	TArray<FSoftClassPath> StateClasses;
+};
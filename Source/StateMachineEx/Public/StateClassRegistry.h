@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+typedef uint16 FStateClassId;
+
+/**
+ * Assigns compact integer ids to UState classes.
+ *
+ * Ids come from UStateClassIdTable, keyed by full class path, so every process that ships the same table agrees on them
+ * whatever content it can see. Classes missing from the table are appended on first use with a warning, such ids are
+ * only valid within the process. Editor-only skeleton and reinstanced classes get no id.
+ *
+ * Lookups are safe from states ticked on worker threads. Loading the table only happens on the game thread.
+ */
+class STATEMACHINEEX_API FStateClassRegistry
+{
+public:
+	static const FStateClassId InvalidId = 0;
+
+	static FStateClassRegistry& Get();
+
+	/** Load the id table. Called by the module after engine init, and on the first lookup if that comes earlier. */
+	void Initialize();
+
+	bool IsInitialized() const { return bInitialized; }
+
+	FStateClassId GetId(const UClass* StateClass);
+	UClass* GetClass(FStateClassId Id) const;
+
+	/** Short class name, for display. */
+	FName GetClassName(FStateClassId Id) const;
+	FName GetClassPath(FStateClassId Id) const;
+
+	int32 Num() const { return Entries.Num(); }
+
+	/** SKEL_, REINST_ and similar classes the editor creates alongside the real Blueprint class. */
+	static bool IsTransientClass(const UClass* Class);
+
+private:
+	FStateClassId AddEntry(FName ClassPath, const UClass* StateClass);
+
+private:
+	struct FEntry
+	{
+		FName ClassPath;
+		FName ClassName;
+		TWeakObjectPtr<UClass> Class;
+	};
+
+	// Index 0 is reserved for InvalidId.
+	TArray<FEntry> Entries;
+
+	TMap<const UClass*, FStateClassId> IdsByClass;
+	TMap<FName, FStateClassId> IdsByPath;
+
+	/** Guards Entries and the maps, which first use may append to while parallel ticks read them. */
+	mutable FRWLock Lock;
+
+	bool bInitialized = false;
+};
+
+/** Bit set over state class ids, for testing a machine against several states at once. */
+struct STATEMACHINEEX_API FStateIdSet
+{
+	FStateIdSet() = default;
+	FStateIdSet(std::initializer_list<const UClass*> StateClasses);
+
+	void Add(FStateClassId Id);
+	void Add(const UClass* StateClass);
+
+	bool Contains(FStateClassId Id) const
+	{
+		return Id < Bits.Num() && Bits[Id];
+	}
+
+private:
+	TBitArray<> Bits;
+};
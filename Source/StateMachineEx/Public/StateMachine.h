@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "StateMachine.generated.h"
 
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnStateMachineStateEntered, class UStateMachine* /*StateMachine*/, class UState* /*State*/);
+
 UCLASS(Blueprintable, BlueprintType)
 class STATEMACHINEEX_API UStateMachine : public UObject
 {
@@ -18,6 +20,17 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine")
 	bool bImmediateStateChange = false;
 
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine|Determinism", meta = (EditCondition = "bFixedStep", ClampMin = "0.001"))
+	float FixedStepSeconds = 1.0f / 30.0f;
+
+	/** Upper bound on catch-up steps per Tick. Time beyond this is dropped. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine|Determinism", meta = (EditCondition = "bFixedStep", ClampMin = "1"))
+	int32 MaxStepsPerTick = 4;
+
+	/** When registered with UStateMachineSubsystem, keep the per-frame data in its structure of arrays storage. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine")
+	bool bUseBulkStorage = false;
+
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine")
 	class UState* CurrentState;
 
@@ -27,10 +40,56 @@ public:
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine")
 	TArray<class UState*> StateStack;
 
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine")
+	bool bDormant = false;
+
+	/** Steps taken through Tick. Machines ticked by the bulk storage fast path do not count. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine|Determinism")
+	int32 SimulationStep = 0;
+
 public:
 	UFUNCTION(BlueprintCallable, Category = "State Machine")
 	bool IsActive() const;
 
+	/** True if the current state is exactly of StateClass. Subclasses do not match, use IsA for that. */
+	UFUNCTION(BlueprintPure, Category = "State Machine")
+	bool IsInState(TSubclassOf<class UState> StateClass) const;
+
+	UFUNCTION(BlueprintPure, Category = "State Machine")
+	float GetTimeInState() const;
+
+	/** Pausing the machine skips its ticks entirely, including pending transitions. */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void SetPaused(bool bInPaused);
+
+	UFUNCTION(BlueprintPure, Category = "State Machine")
+	bool IsPaused() const { return bPaused; }
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine|Determinism")
+	void SetFixedStep(bool bInFixedStep);
+
+	UFUNCTION(BlueprintPure, Category = "State Machine|Determinism")
+	bool IsFixedStep() const { return bFixedStep; }
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine|Determinism")
+	void SetTickOrder(int32 InTickOrder);
+
+	UFUNCTION(BlueprintPure, Category = "State Machine|Determinism")
+	int32 GetTickOrder() const { return TickOrder; }
+
+	/**
+	 * Serialize the live states into a compressed blob and release them. A dormant machine does not tick.
+	 * Switching state or waking restores the states without running Enter.
+	 *
+	 * Only the states' own property data survives. References to objects that are gone by then, including instanced
+	 * subobjects of the states, come back as null.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void Freeze();
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void Wake();
+
 	UFUNCTION(BlueprintCallable, Category = "State Machine")
 	void Restart();
 
@@ -46,6 +105,77 @@ public:
 public:
 	UStateMachine(const FObjectInitializer& ObjectInitializer);
 
+	virtual void BeginDestroy() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif // WITH_EDITOR
+
+	/** Called from a parallel bulk tick, on any thread, the switch is deferred and nullptr is returned. */
 	UState* SwitchState(TSubclassOf<class UState> NewStateClass);
 	UState* SwitchState(class UState* NewState);
+
+	/**
+	 * Native shutdown. The shutdown state, when run, is a per-class instance shared through UStateMachineSubsystem,
+	 * so it must not keep data between uses. It is outered to the subsystem, not the machine, so GetOuter and
+	 * GetTypedOuter do not find the owner from inside it; go through ParentStateMachine instead.
+	 */
+	void Teardown(bool bRunShutdownState);
+
+	bool IsInState(uint16 StateId) const;
+	bool IsInAnyState(const struct FStateIdSet& StateIds) const;
+
+	/** Id of the state that was current before the latest transition. */
+	uint16 GetPreviousStateId() const { return PreviousStateId; }
+
+	/** Fired for every machine right before a state's Enter. Meant for tooling, keep handlers cheap. */
+	static FOnStateMachineStateEntered OnStateEntered;
+
+	/** Cheap hash of the simulation relevant machine state, for comparing runs or client and server. */
+	uint32 GetStateHash() const;
+
+private:
+	friend struct FStateMachineBulkStorage;
+	friend class UStateMachineSubsystem;
+
+	void StepState(float DeltaSeconds);
+	void EnterNextState();
+	void SyncBulkStorage();
+
+	float& TimeInStateRef();
+
+private:
+	/**
+	 * Advance in fixed steps of FixedStepSeconds, resolving transitions only at step boundaries. Overrides
+	 * bImmediateStateChange. Change it at runtime through SetFixedStep so bulk storage notices.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine|Determinism", meta = (AllowPrivateAccess = "true"))
+	bool bFixedStep = false;
+
+	/** Update order within UStateMachineSubsystem. Lower values tick first. Change it at runtime through SetTickOrder. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "State Machine|Determinism", meta = (AllowPrivateAccess = "true"))
+	int32 TickOrder = 0;
+
+	/** Change through SetPaused so bulk storage notices. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "State Machine", meta = (AllowPrivateAccess = "true"))
+	bool bPaused = false;
+
+	UPROPERTY(VisibleInstanceOnly, Category = "State Machine")
+	float TimeInState = 0.0f;
+
+	struct FStateMachineBulkStorage* BulkStorage = nullptr;
+	int32 BulkIndex = INDEX_NONE;
+
+	/**
+	 * Slot in UStateMachineSubsystem's ordered list, INDEX_NONE when not registered there. Bulk machines are never in
+	 * that list, for them it is the slot in the subsystem's dormant list while frozen.
+	 */
+	int32 RegistryIndex = INDEX_NONE;
+
+	TArray<uint8> DormantData;
+	bool bDormantInBulkStorage = false;
+
+	float StepAccumulator = 0.0f;
+	uint16 PreviousStateId = 0;
+	bool bTearingDown = false;
 };
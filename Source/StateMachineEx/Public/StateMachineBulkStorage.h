@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "StateClassRegistry.h"
+#include "Containers/Queue.h"
+
+class UStateMachine;
+class UState;
+
+/**
+ * Structure of arrays runtime data for machines registered with bUseBulkStorage.
+ *
+ * The per-frame loop only reads these arrays and the current state, the UStateMachine objects are touched only when a
+ * transition is pending or a machine needs fixed stepping. Slots keep registration order, removed slots are compacted
+ * on the next tick.
+ *
+ * Slots whose current state opts in through UState::CanTickInParallel are ticked together on worker threads after the
+ * serial pass. State switches requested there are queued and applied on the game thread in slot order, and in request
+ * order within a slot, so the result does not depend on thread timing.
+ */
+struct STATEMACHINEEX_API FStateMachineBulkStorage
+{
+	TArray<UStateMachine*> Machines;
+	TArray<UState*> CurrentStates;
+	TArray<FStateClassId> CurrentStateIds;
+	TArray<FStateClassId> PendingStateIds;
+	TArray<float> TimeInState;
+	TBitArray<> Paused;
+	TBitArray<> NeedsFullTick;
+	TBitArray<> TickInParallel;
+
+	/** Set when a switch is queued for the slot. Bytes rather than bits, workers write their own slots concurrently. */
+	TArray<bool> SwitchRequested;
+
+	int32 Num() const { return Machines.Num(); }
+	bool Contains(const UStateMachine* StateMachine) const;
+
+	int32 Add(UStateMachine* StateMachine);
+	void Remove(UStateMachine* StateMachine);
+	void Compact();
+	void Reset();
+
+	void Tick(float DeltaSeconds);
+
+	int32 CountInState(FStateClassId StateId) const;
+
+	/** Thread safe, applied at the end of the current Tick. */
+	void DeferSwitchState(UStateMachine* StateMachine, UClass* StateClass, UState* State);
+
+	/** The game thread runs part of the parallel pass itself, so IsInGameThread alone cannot tell when to defer. */
+	bool IsTickingInParallel() const { return bTickingInParallel; }
+
+	static bool CanTickInParallel(const UState* State);
+	static bool RequiresFullTick(const UStateMachine* StateMachine);
+
+	void AddReferencedObjects(FReferenceCollector& Collector, const UObject* ReferencingObject);
+
+private:
+	void ApplyDeferredSwitches();
+
+private:
+	struct FDeferredSwitch
+	{
+		int32 Index;
+		UStateMachine* StateMachine;
+		UClass* StateClass;
+		UState* State;
+	};
+
+	/** No garbage collection runs between queueing and applying, so raw pointers are fine here. */
+	TQueue<FDeferredSwitch, EQueueMode::Mpsc> DeferredSwitches;
+
+	/** Scratch list for sorting the queued switches, kept to avoid reallocating every frame. */
+	TArray<FDeferredSwitch> SortedSwitches;
+
+	/** Scratch list of slots for the parallel pass, kept to avoid reallocating every frame. */
+	TArray<int32> ParallelIndices;
+
+	bool bNeedsCompact = false;
+	bool bTickingInParallel = false;
+};
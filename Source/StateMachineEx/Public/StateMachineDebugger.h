@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "StateClassRegistry.h"
+
+class UStateMachine;
+class UState;
+
+/** The last few transitions of one machine. */
+struct STATEMACHINEEX_API FStateMachineDebugRecord
+{
+	static const int32 MaxTransitions = 8;
+
+	struct FTransition
+	{
+		FStateClassId FromStateId = FStateClassRegistry::InvalidId;
+		FStateClassId ToStateId = FStateClassRegistry::InvalidId;
+		float WorldTime = 0.0f;
+	};
+
+	FTransition Transitions[MaxTransitions];
+	int32 NumTransitions = 0;
+
+	void Add(FStateClassId FromStateId, FStateClassId ToStateId, float WorldTime);
+
+	/** Index 0 is the most recent transition. */
+	const FTransition& GetRecent(int32 Index) const;
+	int32 NumRecent() const { return FMath::Min(NumTransitions, MaxTransitions); }
+};
+
+/**
+ * Live inspection of state machines for the gameplay debugger and console commands.
+ *
+ * Transitions are only recorded while at least one viewer is attached. Until then nothing is bound to
+ * UStateMachine::OnStateEntered and no records exist.
+ */
+class STATEMACHINEEX_API FStateMachineDebugger
+{
+public:
+	static FStateMachineDebugger& Get();
+
+	void AddViewer();
+	void RemoveViewer();
+	bool IsRecording() const { return NumViewers > 0; }
+
+	const FStateMachineDebugRecord* FindRecord(const UStateMachine* StateMachine) const;
+
+	/** Human readable summary, one line for the machine followed by its recent transitions. */
+	void Describe(const UStateMachine* StateMachine, TArray<FString>& OutLines) const;
+
+	/**
+	 * Machines registered with World's UStateMachineSubsystem, nearest to Origin first. A Radius of zero or less
+	 * matches everything, machines without an owning actor then come last; with a Radius they are left out. Machines
+	 * ticked by their owners are not found, select the owner to see those.
+	 */
+	static void GatherStateMachines(UWorld* World, const FVector& Origin, float Radius, int32 MaxCount, TArray<UStateMachine*>& OutStateMachines);
+
+private:
+	void OnStateEntered(UStateMachine* StateMachine, UState* State);
+	void PruneRecords();
+
+private:
+	enum { MinRecordsBeforePrune = 256 };
+
+	/** Records of collected machines are dropped whenever the map has doubled since the last prune. */
+	TMap<TWeakObjectPtr<const UStateMachine>, FStateMachineDebugRecord> Records;
+	int32 NumRecordsBeforePrune = MinRecordsBeforePrune;
+	FDelegateHandle StateEnteredHandle;
+	int32 NumViewers = 0;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "StateMachineBulkStorage.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "StateMachineSubsystem.generated.h"
+
+USTRUCT(BlueprintType)
+struct STATEMACHINEEX_API FStateMachineTeardownStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "State Machine")
+	int32 NumStateMachines = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "State Machine")
+	int32 NumFrames = 0;
+
+	/** Time spent inside teardown batches, not wall time across frames. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "State Machine")
+	float Seconds = 0.0f;
+};
+
+UCLASS()
+class STATEMACHINEEX_API UStateMachineSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UStateMachineSubsystem* Get(const UObject* WorldContextObject);
+
+public:
+	/**
+	 * Registered machines are ticked by the subsystem, ordered by TickOrder and then by registration order.
+	 * Machines with bUseBulkStorage tick after those, in registration order.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void RegisterStateMachine(class UStateMachine* StateMachine);
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void UnregisterStateMachine(class UStateMachine* StateMachine);
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void TickStateMachines(float DeltaSeconds);
+
+	/**
+	 * Unregister and shut down every registered machine, MachinesPerFrame at a time (0 does them all this frame).
+	 * Machines waiting for teardown are no longer ticked. The latest call's options apply to the whole queue.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void ShutdownAll(bool bRunShutdownStates = true, int32 MachinesPerFrame = 0);
+
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void QueueShutdown(class UStateMachine* StateMachine, bool bRunShutdownStates = true, int32 MachinesPerFrame = 0);
+
+	/** Queue every registered machine that lives inside Outer, for example a streaming level about to unload. */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void QueueShutdownWithin(UObject* Outer, bool bRunShutdownStates = true, int32 MachinesPerFrame = 0);
+
+	/** Shut down everything still queued right away. */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void FlushShutdowns();
+
+	UFUNCTION(BlueprintPure, Category = "State Machine")
+	bool IsShuttingDown() const { return PendingShutdowns.Num() > 0; }
+
+	UFUNCTION(BlueprintPure, Category = "State Machine")
+	const FStateMachineTeardownStats& GetLastTeardownStats() const { return LastTeardownStats; }
+
+	/** One instance per class, outered to this subsystem. Reach the machine being shut down through ParentStateMachine. */
+	class UState* GetSharedShutdownState(TSubclassOf<class UState> StateClass);
+
+	/** Freeze or wake every registered machine that lives inside Outer, for example a streaming level or an actor. */
+	UFUNCTION(BlueprintCallable, Category = "State Machine")
+	void SetDormantWithin(UObject* Outer, bool bDormant);
+
+	const FStateMachineBulkStorage& GetBulkStorage() const { return BulkStorage; }
+
+	/** Every machine registered here, including bulk and dormant bulk ones. */
+	void GetRegisteredStateMachines(TArray<class UStateMachine*>& OutStateMachines) const;
+
+public:
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaSeconds) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	friend class UStateMachine;
+
+	void AddDormantBulkStateMachine(class UStateMachine* StateMachine);
+	void RemoveDormantBulkStateMachine(class UStateMachine* StateMachine);
+	void CompactDormantBulkStateMachines();
+
+	void SortStateMachines();
+	void SetShutdownOptions(bool bInRunShutdownStates, int32 MachinesPerFrame);
+	void ProcessShutdowns(int32 MaxCount);
+
+private:
+	UPROPERTY(Transient)
+	TArray<class UStateMachine*> StateMachines;
+
+	FStateMachineBulkStorage BulkStorage;
+
+	/**
+	 * Bulk machines leave the storage while dormant, so Freeze and Wake track them here. Holes left by woken or
+	 * unregistered machines are compacted once they make up half the list.
+	 */
+	TArray<TWeakObjectPtr<class UStateMachine>> DormantBulkStateMachines;
+	int32 NumDormantBulkHoles = 0;
+
+	UPROPERTY(Transient)
+	TArray<class UStateMachine*> PendingShutdowns;
+
+	UPROPERTY(Transient)
+	TMap<UClass*, class UState*> SharedShutdownStates;
+
+	int32 NextShutdownIndex = 0;
+	int32 ShutdownsPerFrame = 0;
+	bool bRunShutdownStates = true;
+	bool bProcessingShutdowns = false;
+
+	FStateMachineTeardownStats CurrentTeardownStats;
+	FStateMachineTeardownStats LastTeardownStats;
+
+	bool bNeedsSort = false;
+};
@@ -24,5 +24,7 @@ public class StateMachineEx : ModuleRules
 			"CoreUObject",
 			"Engine",
 		});
+
+		SetupGameplayDebuggerSupport(Target);
 	}
 }